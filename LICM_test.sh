@@ -22,11 +22,12 @@ echo "✅ All .ll files saved under $OUT_ROOT/"
 
 shopt -s nullglob dotglob
 
-SRC_ROOT="build/tests/llopt"
+SRC_ROOT="$OUT_ROOT"
 BUILD_DIR="/home/matija/llvm-project/build"
 OPT="$BUILD_DIR/bin/opt"
 DOT_CMD="dot"
 LICM_PASS="lib/LLVMMyLICMPass.so"
+FAILED=0
 
 for srcd in "$SRC_ROOT"/*/; do
   [ -d "$srcd" ] || continue
@@ -37,6 +38,15 @@ for srcd in "$SRC_ROOT"/*/; do
   ll_in="$base.ll"
   ll_out="$base.opt.ll"
   log_out="$base.opt.log"
+  # A test may set options and expect lines in the log or the optimized IR, in
+  # comments of its source:
+  #   // my-licm flags: -my-licm-unroll-hints
+  #   // expect: Parallel loop: for.cond
+  #   // expect-not: Parallel loop
+  #   // expect-ir: !llvm.access.group
+  #   // expect-ir-not: llvm.loop.parallel_accesses
+  src_c="$PWD/$SRC_DIR/$base.c"
+  read -r -a flags <<< "$(sed -n 's|^// my-licm flags: ||p' "$src_c")"
 
   cd "$OUT_DIR"
 
@@ -55,12 +65,42 @@ for srcd in "$SRC_ROOT"/*/; do
   echo "→ Running LICM on $ll_in → $ll_out"
   # Dump all output (stdout + stderr) to a .log file, overwrite each time
   if ! "$OPT" -S -load "$BUILD_DIR/$LICM_PASS" \
-      --bugpoint-enable-legacy-pm -my-licm \
+      --bugpoint-enable-legacy-pm -my-licm ${flags[@]+"${flags[@]}"} \
       "$ll_in" -o "$ll_out" >"$log_out" 2>&1; then
     echo "⚠️  LICM pass failed for $base — see $log_out"
     cd - >/dev/null
+    FAILED=1
     continue
   fi
+  if ! "$OPT" -passes=verify -disable-output "$ll_out" >>"$log_out" 2>&1; then
+    echo "❌ $base: $ll_out does not verify — see $log_out"
+    FAILED=1
+  fi
+
+  while IFS= read -r line; do
+    if ! grep -qF -- "$line" "$log_out"; then
+      echo "❌ $base: expected \"$line\" in $log_out"
+      FAILED=1
+    fi
+  done < <(sed -n 's|^// expect: ||p' "$src_c")
+  while IFS= read -r line; do
+    if grep -qF -- "$line" "$log_out"; then
+      echo "❌ $base: did not expect \"$line\" in $log_out"
+      FAILED=1
+    fi
+  done < <(sed -n 's|^// expect-not: ||p' "$src_c")
+  while IFS= read -r line; do
+    if ! grep -qF -- "$line" "$ll_out"; then
+      echo "❌ $base: expected \"$line\" in $ll_out"
+      FAILED=1
+    fi
+  done < <(sed -n 's|^// expect-ir: ||p' "$src_c")
+  while IFS= read -r line; do
+    if grep -qF -- "$line" "$ll_out"; then
+      echo "❌ $base: did not expect \"$line\" in $ll_out"
+      FAILED=1
+    fi
+  done < <(sed -n 's|^// expect-ir-not: ||p' "$src_c")
 
   echo "→ Generating DOTs for $base.opt.ll"
   "$OPT" -passes=dot-cfg -disable-output "$ll_out"
@@ -77,4 +117,5 @@ for srcd in "$SRC_ROOT"/*/; do
 done
 
 echo "✅ All optimized .ll files and CFG PNGs saved under $SRC_ROOT/"
+exit $FAILED
 
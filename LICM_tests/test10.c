@@ -0,0 +1,9 @@
+// test10_same_pointer_store.c
+// expect-not: Parallel loop
+// expect-ir-not: llvm.loop.parallel_accesses
+// expect-ir-not: !llvm.access.group
+void foo(int *p, int *a, int n) {
+    for (int i = 0; i < n; i++) {
+        *p = a[i]; // every iteration stores to the same place
+    }
+}
@@ -0,0 +1,14 @@
+// test11_constant_trip_count.c
+// my-licm flags: -my-licm-unroll-hints
+// expect: Parallel loop: for.cond
+// expect: Unroll count 4: for.cond
+// expect-ir: !llvm.access.group
+// expect-ir: !"llvm.loop.parallel_accesses"
+// expect-ir: !"llvm.loop.unroll.count", i32 4
+int A[100];
+
+void foo(int k) {
+    for (int i = 0; i < 100; i++) {
+        A[i] = A[i] + k; // 100 iterations, largest power of two <= 8 dividing 100
+    }
+}
@@ -0,0 +1,12 @@
+// test12_work_budget_degraded.c
+// my-licm flags: -my-licm-work-budget=30 -pass-remarks-missed=my-licm
+// expect: foo: over the function compile-time budget after
+// expect: switching to cheaper analyses
+// expect-not: leaving the rest of the function as it is
+// expect-not: Parallel loop
+// expect-ir-not: llvm.loop.parallel_accesses
+void foo(int *restrict a, int *restrict b, int c, int n) {
+    for (int i = 0; i < n; i++) {
+        a[i] = b[i] + c; // as test8, but the cheaper analyses never prove the loop parallel
+    }
+}
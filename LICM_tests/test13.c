@@ -0,0 +1,13 @@
+// test13_work_budget_exhausted.c
+// my-licm flags: -my-licm-work-budget=1 -pass-remarks-missed=my-licm
+// expect: foo: over the function compile-time budget after
+// expect: leaving the rest of the function as it is
+// expect-not: Hoisting:
+int foo(int n) {
+    int x = 5;
+    int sum = 0;
+    for (int i = 0; i < n; i++) {
+        sum += x * 2; // invariant as in test1, but the loop is left alone
+    }
+    return sum;
+}
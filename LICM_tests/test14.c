@@ -0,0 +1,11 @@
+// test14_base_reassigned_in_loop.c
+// expect-not: Parallel loop
+// expect-ir-not: llvm.loop.parallel_accesses
+// expect-ir-not: !llvm.access.group
+void foo(int *restrict a, int *restrict b, int n) {
+    int *p;
+    for (int i = 0; i < n; i++) {
+        p = (i & 1) ? a : b; // the only store to p, but a new base every iteration
+        p[i + 1] = b[i];     // writes b[i + 1] on even i, the next iteration reads it
+    }
+}
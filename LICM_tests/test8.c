@@ -0,0 +1,10 @@
+// test8_parallel_restrict.c
+// expect: Parallel loop: for.cond
+// expect-ir: !llvm.access.group
+// expect-ir: !"llvm.loop.parallel_accesses"
+// expect-ir: !"llvm.loop.vectorize.enable", i1 true
+void foo(int *restrict a, int *restrict b, int c, int n) {
+    for (int i = 0; i < n; i++) {
+        a[i] = b[i] + c; // a and b never overlap, iterations are independent
+    }
+}
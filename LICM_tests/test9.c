@@ -0,0 +1,9 @@
+// test9_carried_dependence.c
+// expect-not: Parallel loop
+// expect-ir-not: llvm.loop.parallel_accesses
+// expect-ir-not: !llvm.access.group
+void foo(int *a, int n) {
+    for (int i = 0; i < n; i++) {
+        a[i + 1] = a[i]; // reads what the previous iteration stored
+    }
+}
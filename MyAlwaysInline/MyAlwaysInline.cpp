@@ -1,77 +1,818 @@
 #include "llvm/Pass.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/BranchProbabilityInfo.h"
+#include "llvm/Analysis/CallGraph.h"
+#include "llvm/Analysis/InlineCost.h"
+#include "llvm/Analysis/InstructionSimplify.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ProfileSummaryInfo.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
 #include "llvm/IR/Attributes.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Dominators.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/PassManager.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Linker/IRMover.h"
 #include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
 #include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/CodeExtractor.h"
+#include "llvm/Transforms/Utils/Local.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/Transforms/Scalar.h"
 
+#include "CompileBudget.h"
+#include "CostReport.h"
+
 using namespace llvm;
 
+enum class InlineMode { Always, Cost };
+
+static cl::opt<InlineMode> Mode(
+    "my-inline-mode", cl::desc("Which call sites my-always-inline inlines"),
+    cl::init(InlineMode::Always),
+    cl::values(clEnumValN(InlineMode::Always, "always", "Only callees marked alwaysinline"),
+               clEnumValN(InlineMode::Cost, "cost", "Any callee the inline cost model accepts")));
+
+static cl::opt<int> CostThreshold(
+    "my-inline-threshold", cl::init(225),
+    cl::desc("Inline cost threshold for -my-inline-mode=cost"));
+
+static cl::opt<int> HotCallSiteThreshold(
+    "my-inline-hot-threshold", cl::init(525),
+    cl::desc("Inline cost threshold for call sites that are hot relative to their caller"));
+
+static cl::opt<unsigned> CallerBudget(
+    "my-inline-caller-budget", cl::init(2000),
+    cl::desc("Instructions a single caller may grow by in -my-inline-mode=cost"));
+
+static cl::opt<unsigned> ModuleBudget(
+    "my-inline-module-budget", cl::init(20000),
+    cl::desc("Instructions the whole module may grow by in -my-inline-mode=cost"));
+
+static cl::opt<bool> PartialInline(
+    "my-partial-inline", cl::init(false),
+    cl::desc("Inline only the early-exit guard of callees that are not inlined whole"));
+
+static cl::opt<unsigned> PartialMaxGuard(
+    "my-partial-inline-max-guard", cl::init(16),
+    cl::desc("Most instructions the inlined guard region may have"));
+
+static cl::opt<unsigned> PartialMinProb(
+    "my-partial-inline-min-prob", cl::init(50),
+    cl::desc("Lowest probability, in percent, of the early exit for it to be the hot path"));
+
+static cl::opt<bool> InlineCleanup(
+    "my-inline-cleanup", cl::init(true),
+    cl::desc("Simplify each freshly inlined body right after it is cloned"));
+
+static cl::opt<bool> MergeAllocas(
+    "my-inline-merge-allocas", cl::init(true),
+    cl::desc("Share stack slots whose lifetime markers show they are never live together"));
+
+static cl::list<std::string> ImportFiles(
+    "my-inline-import", cl::CommaSeparated, cl::value_desc("bitcode files"),
+    cl::desc("Local bitcode files to import externally visible alwaysinline definitions from"));
+
+static cl::opt<std::string> CostReportFile(
+    "my-inline-cost-report", cl::value_desc("filename"),
+    cl::desc("Append the TTI cost of every function before and after my-always-inline to this file as JSON lines"));
+
+static cl::opt<uint64_t> WorkBudget(
+    "my-inline-work-budget", cl::init(0),
+    cl::desc("Instructions my-always-inline may visit and clone into one caller before it degrades (0: no limit)"));
+
+static cl::opt<uint64_t> TimeBudget(
+    "my-inline-time-budget-ms", cl::init(0),
+    cl::desc("Milliseconds my-always-inline may spend on one caller before it degrades (0: no limit)"));
+
+static cl::opt<uint64_t> ModuleWorkBudget(
+    "my-inline-module-work-budget", cl::init(0),
+    cl::desc("Instructions my-always-inline may visit and clone in the whole module before it degrades (0: no limit)"));
+
+static cl::opt<uint64_t> ModuleTimeBudget(
+    "my-inline-module-time-budget-ms", cl::init(0),
+    cl::desc("Milliseconds my-always-inline may spend on the whole module before it degrades (0: no limit)"));
+
 namespace {
 struct MyAlwaysInline : public ModulePass {
   static char ID;
   MyAlwaysInline() : ModulePass(ID) {}
 
-  bool runOnModule(Module &M) override {
+  // Functions that can reach themselves through calls, inlining them would never finish
+  SmallPtrSet<Function*, 16> Recursive;
+
+  // Block frequencies for the cost model, rebuilt after a function changes
+  struct FunctionFreq {
+    DominatorTree DT;
+    LoopInfo LI;
+    BranchProbabilityInfo BPI;
+    BlockFrequencyInfo BFI;
+    FunctionFreq(Function &F, const TargetLibraryInfo &TLI)
+        : DT(F), LI(DT), BPI(F, LI, &TLI), BFI(F, BPI, LI) {}
+  };
+  std::map<Function*, std::unique_ptr<FunctionFreq>> Freqs;
+
+  DenseMap<Function*, unsigned> CallerGrowth;
+  unsigned ModuleGrowth = 0;
+
+  // Call sites inlined into each caller, whole or partially, for the cost report
+  DenseMap<Function*, unsigned> InlineCounts;
+
+  // Over budget, only alwaysinline callees are inlined, without the calls
+  // their bodies bring in, partial inlining or cleanup
+  mypassutils::CompileBudget Budget{"my-always-inline", {}, {}};
+
+  BlockFrequencyInfo &getBFI(Function &F) {
+    auto &Freq = Freqs[&F];
+    if (!Freq)
+      Freq = std::make_unique<FunctionFreq>(F, getAnalysis<TargetLibraryInfoWrapperPass>().getTLI(F));
+    return Freq->BFI;
+  }
+
+  // Scores the call site with InlineCost, which already credits constant
+  // arguments, blocks they make dead and removing the last call to a local callee
+  bool isWorthInlining(CallBase &CB, Function &Callee) {
+    Function &Caller = *CB.getCaller();
+    InlineParams Params = getInlineParams(CostThreshold);
+    Params.LocallyHotCallSiteThreshold = HotCallSiteThreshold;
+
+    auto GetAC = [&](Function &F) -> AssumptionCache & {
+      return getAnalysis<AssumptionCacheTracker>().getAssumptionCache(F);
+    };
+    auto GetTLI = [&](Function &F) -> const TargetLibraryInfo & {
+      return getAnalysis<TargetLibraryInfoWrapperPass>().getTLI(F);
+    };
+    auto GetBFI = [&](Function &F) -> BlockFrequencyInfo & { return getBFI(F); };
+
+    TargetTransformInfo &TTI = getAnalysis<TargetTransformInfoWrapperPass>().getTTI(Callee);
+    ProfileSummaryInfo *PSI = &getAnalysis<ProfileSummaryInfoWrapperPass>().getPSI();
+
+    InlineCost IC = getInlineCost(CB, Params, TTI, GetAC, GetTLI, GetBFI, PSI);
+    if (IC.isAlways()) return true;
+    if (!IC) return false;
+
+    // Keep code size bounded per caller and for the whole module
+    unsigned Growth = Callee.getInstructionCount();
+    if (CallerGrowth[&Caller] + Growth > CallerBudget) return false;
+    if (ModuleGrowth + Growth > ModuleBudget) return false;
+    return true;
+  }
+
+  // Charges the growth isWorthInlining allowed, once the call is really inlined;
+  // alwaysinline calls (on the call site or the callee) are never charged
+  void chargeGrowth(Function &Caller, Function &Callee, bool IsAlways) {
+    if (Mode != InlineMode::Cost || IsAlways) return;
+    unsigned Growth = Callee.getInstructionCount();
+    CallerGrowth[&Caller] += Growth;
+    ModuleGrowth += Growth;
+  }
+
+  // Guard-only clones of callees, or nullptr where the callee has no usable shape
+  DenseMap<Function*, Function*> PartialClones;
+
+  // For a callee shaped as `entry: br C, ret_block, slow_path`, clones it and
+  // outlines everything but the entry and the return block into a cold function
+  Function *splitForPartialInlining(Function &F) {
+    // The linker may pick another definition of a weak or linkonce callee
+    if (F.isInterposable() || F.isVarArg() || F.hasFnAttribute(Attribute::NoInline) || F.size() < 3) return nullptr;
+
+    BasicBlock &Entry = F.getEntryBlock();
+    auto *Br = dyn_cast<BranchInst>(Entry.getTerminator());
+    if (!Br || !Br->isConditional()) return nullptr;
+
+    // The early exit must be the only return of the function
+    BasicBlock *RetBB = nullptr;
+    for (BasicBlock &BB : F) {
+      if (!isa<ReturnInst>(BB.getTerminator())) continue;
+      if (RetBB) return nullptr;
+      RetBB = &BB;
+    }
+    if (!RetBB || RetBB == &Entry) return nullptr;
+
+    BasicBlock *Slow = Br->getSuccessor(0) == RetBB ? Br->getSuccessor(1) : Br->getSuccessor(0);
+    if (Slow == RetBB || (Br->getSuccessor(0) != RetBB && Br->getSuccessor(1) != RetBB)) return nullptr;
+    if (Entry.size() + RetBB->size() > PartialMaxGuard) return nullptr;
+
+    // Only worth it when the early exit is the hot path
+    getBFI(F);
+    if (Freqs[&F]->BPI.getEdgeProbability(&Entry, RetBB) < BranchProbability(PartialMinProb, 100))
+      return nullptr;
+
+    // The slow path must be entered only through Slow and may not loop back
+    // to the entry; RetBB ends in the only return, so it leads nowhere else
+    for (BasicBlock &BB : F) {
+      if (&BB == &Entry || &BB == RetBB) continue;
+      for (BasicBlock *Pred : predecessors(&BB))
+        if (Pred == &Entry && &BB != Slow) return nullptr;
+      for (BasicBlock *Succ : successors(&BB))
+        if (Succ == &Entry) return nullptr;
+    }
+
+    ValueToValueMapTy VMap;
+    Function *Clone = CloneFunction(&F, VMap);
+    Clone->setName(F.getName() + ".guard");
+    Clone->setLinkage(GlobalValue::InternalLinkage);
+    Clone->setComdat(nullptr);
+
+    SmallVector<BasicBlock*, 16> Region = {cast<BasicBlock>(VMap[Slow])};
+    for (BasicBlock &BB : F)
+      if (&BB != &Entry && &BB != RetBB && &BB != Slow)
+        Region.push_back(cast<BasicBlock>(VMap[&BB]));
+
+    DominatorTree DT(*Clone);
+    CodeExtractor CE(Region, &DT);
+    CodeExtractorAnalysisCache CEAC(*Clone);
+    Function *Cold = CE.isEligible() ? CE.extractCodeRegion(CEAC) : nullptr;
+    if (!Cold) {
+      Clone->eraseFromParent();
+      return nullptr;
+    }
+
+    Cold->setName(F.getName() + ".cold");
+    Cold->addFnAttr(Attribute::Cold);
+    Cold->addFnAttr(Attribute::NoInline);
+    return Clone;
+  }
+
+  // Inlines only the guard of the callee, leaving a call to its cold remainder
+  bool partiallyInline(CallBase &CB) {
+    Function *Callee = CB.getCalledFunction();
+    if (!Callee || Callee->isDeclaration() || Recursive.count(Callee)) return false;
+
+    auto It = PartialClones.find(Callee);
+    if (It == PartialClones.end())
+      It = PartialClones.insert({Callee, splitForPartialInlining(*Callee)}).first;
+    Function *Guard = It->second;
+    if (!Guard) return false;
+
+    CB.setCalledFunction(Guard);
+    InlineFunctionInfo IFI;
+    if (!InlineFunction(CB, IFI).isSuccess()) {
+      CB.setCalledFunction(Callee);
+      return false;
+    }
+    return true;
+  }
+
+  bool shouldInline(CallBase &CB) {
+    Function *Callee = CB.getCalledFunction();
+    if (!Callee) return false;
+    if (Callee->isDeclaration()) return false;
+    if (Recursive.count(Callee)) return false;
+
+    if (Mode == InlineMode::Cost && !Budget.isDegraded())
+      return isWorthInlining(CB, *Callee);
+
+    // Only inline if the callee explicitly demands it.
+    return Callee->hasFnAttribute(Attribute::AlwaysInline);
+  }
+
+  // Simplifies only what InlineFunction just cloned: the code between Prev
+  // (the instruction that preceded the call, or the start of First) and Next,
+  // plus Next itself, which now uses the inlined return value. The cloned
+  // blocks always sit between the call block and the block of Next.
+  static void cleanupInlinedRegion(BasicBlock *First, Instruction *PrevI, Instruction *NextI) {
+    SmallVector<BasicBlock*, 8> Blocks;
+    for (BasicBlock *BB = First; BB; BB = BB->getNextNode()) {
+      Blocks.push_back(BB);
+      if (BB == NextI->getParent()) break;
+    }
+    if (Blocks.back() != NextI->getParent()) return;
+
+    // Folding may erase the bounds themselves, the region then extends to the block edges
+    WeakVH Prev(PrevI), Next(NextI);
+    BasicBlock *Last = Blocks.back();
+
+    const DataLayout &DL = First->getModule()->getDataLayout();
+    auto Simplify = [&]() {
+      SmallVector<WeakTrackingVH, 32> Worklist;
+      for (BasicBlock *BB : Blocks) {
+        auto It = BB == First && Prev ? std::next(cast<Instruction>(Prev)->getIterator()) : BB->begin();
+        for (; It != BB->end() && &*It != Next; ++It)
+          Worklist.push_back(&*It);
+      }
+      if (Next)
+        Worklist.push_back(cast<Instruction>(Next));
+
+      while (!Worklist.empty()) {
+        auto *I = dyn_cast_or_null<Instruction>(Worklist.pop_back_val());
+        if (!I || !I->getParent()) continue;
+
+        if (isInstructionTriviallyDead(I)) {
+          for (Value *Op : I->operands())
+            if (isa<Instruction>(Op))
+              Worklist.push_back(Op);
+          I->eraseFromParent();
+          continue;
+        }
+
+        Value *V = simplifyInstruction(I, DL);
+        if (!V) continue;
+        for (User *U : I->users())
+          Worklist.push_back(U);
+        I->replaceAllUsesWith(V);
+        if (isInstructionTriviallyDead(I))
+          I->eraseFromParent();
+      }
+    };
+
+    // Constant arguments are now plain operands, fold what depends on them
+    Simplify();
+
+    // Branches on now constant conditions, then the cloned blocks nothing reaches
+    for (BasicBlock *BB : Blocks)
+      ConstantFoldTerminator(BB, true);
+
+    SmallPtrSet<BasicBlock*, 8> Dead;
+    bool Changed = true;
+    while (Changed) {
+      Changed = false;
+      for (BasicBlock *BB : Blocks)
+        if (BB != First && !Dead.count(BB) && pred_empty(BB)) {
+          Dead.insert(BB);
+          DeleteDeadBlock(BB);
+          Changed = true;
+        }
+    }
+    if (Dead.empty() || Dead.count(Last)) return;
+
+    // Removed edges leave single-entry phis behind
+    erase_if(Blocks, [&](BasicBlock *BB) { return Dead.count(BB); });
+    Simplify();
+  }
+
+  // Inlines every qualifying call in F, including the calls that inlined bodies bring in
+  bool inlineCallsIn(Function &F, SmallSetVector<Function*, 16> &ToErase) {
     bool Changed = false;
-    SmallVector<Function*, 16> ToErase;
+    // Cleanup after inlining may delete calls that are still queued
+    SmallVector<WeakTrackingVH, 16> Worklist;
+    for (Instruction &I : instructions(F))
+      if (isa<CallBase>(&I))
+        Worklist.push_back(&I);
 
-      for (Function &F : M) {
-        // Skip declarations (external functions) – they can’t contain call sites we can inline.
-        if (F.isDeclaration()) continue;
-
-        // We mutate while iterating, so use a manual iterator pattern over instructions.
-        for (BasicBlock &BB : F) {
-          for (auto It = BB.begin(); It != BB.end(); ) {
-            Instruction &I = *It++;
-            auto *CB = dyn_cast<CallBase>(&I);
-            if (!CB) continue;
-
-            Function *Callee = CB->getCalledFunction();
-            if (!Callee) continue;
-            if (Callee->isDeclaration()) continue;
-
-            // Only inline if the callee explicitly demands it.
-            if (!Callee->hasFnAttribute(Attribute::AlwaysInline)) continue;
-
-            // Use NoRecurse attribute from function-attr pass
-            // to avoid recursive functions which create infinite code
-            if (!Callee->hasFnAttribute(llvm::Attribute::NoRecurse)) continue;
-
-            // Call built-in inlining function
-            InlineFunctionInfo IFI;
-            auto Ret = InlineFunction(*CB, IFI);
-            if (Ret.isSuccess()) Changed = true;
-
-            // Add functions that are no longer used to vector
-            if (Callee->use_empty() && !Callee->isDeclaration() &&
-                (Callee->hasLocalLinkage() || Callee->hasLinkOnceODRLinkage()))
-                    ToErase.push_back(Callee);
+    while (!Worklist.empty()) {
+      auto *CB = dyn_cast_or_null<CallBase>(Worklist.pop_back_val());
+      if (!CB) continue;
+      // The caller stays correct with calls left in it
+      if (Budget.charge() == mypassutils::CompileBudget::Exhausted) break;
+      if (!shouldInline(*CB)) {
+        if (PartialInline && !Budget.isDegraded() && partiallyInline(*CB)) {
+          Changed = true;
+          Freqs.erase(&F);
+          ++InlineCounts[&F];
+        }
+        continue;
+      }
+
+      Function *Callee = CB->getCalledFunction();
+
+      // Invokes end their block, their cloned region has no single end point
+      BasicBlock *CallBB = CB->getParent();
+      Instruction *Prev = CB->getPrevNode();
+      Instruction *Next = CB->getNextNode();
+      bool IsAlways = CB->hasFnAttr(Attribute::AlwaysInline);
+
+      // Call built-in inlining function
+      InlineFunctionInfo IFI;
+      if (!InlineFunction(*CB, IFI).isSuccess()) continue;
+      chargeGrowth(F, *Callee, IsAlways);
+      Changed = true;
+      Freqs.erase(&F);
+      ++InlineCounts[&F];
+      Budget.charge(Callee->getInstructionCount());
+
+      // Callees are flattened before their callers, so what cascades from
+      // here is mostly calls they could not inline themselves
+      if (!Budget.isDegraded())
+        for (WeakTrackingVH &V : IFI.InlinedCalls)
+          if (isa_and_nonnull<CallBase>(V))
+            Worklist.push_back(V);
+
+      if (InlineCleanup && Next && !Budget.isDegraded())
+        cleanupInlinedRegion(CallBB, Prev, Next);
+
+      // Add functions that are no longer used to vector
+      if (Callee->use_empty() && (Callee->hasLocalLinkage() || Callee->hasLinkOnceODRLinkage()))
+        ToErase.insert(Callee);
+    }
+
+    return Changed;
+  }
+
+  // Memory touched through V is private to F if it is one of F's own stack slots
+  static bool isLocalMemory(Value *Ptr, Function &F) {
+    auto *AI = dyn_cast<AllocaInst>(getUnderlyingObject(Ptr));
+    return AI && AI->getFunction() == &F;
+  }
+
+  static bool isKnownNonNullReturn(Value *V) {
+    if (auto *GV = dyn_cast<GlobalValue>(V)) return !GV->hasExternalWeakLinkage();
+    if (auto *A = dyn_cast<Argument>(V)) return A->hasNonNullAttr();
+    if (auto *CB = dyn_cast<CallBase>(V)) return CB->hasRetAttr(Attribute::NonNull);
+    return false;
+  }
+
+  // Inlining keeps the caller's behaviour, so its existing attributes stay
+  // valid; the now visible callee bodies can only let us infer more of them
+  static void reinferAttributes(Function &F) {
+    // The linker may pick another definition of a weak or linkonce function
+    if (!F.hasExactDefinition()) return;
+
+    bool MayThrow = false, Reads = false, Writes = false, CallsRecursive = false;
+    SmallVector<Value*, 4> Returned;
+
+    for (Instruction &I : instructions(F)) {
+      MayThrow |= I.mayThrow();
+
+      if (auto *CB = dyn_cast<CallBase>(&I)) {
+        if (CB->isLifetimeStartOrEnd()) continue;
+        Function *Callee = CB->getCalledFunction();
+        if (!Callee || (!Callee->isIntrinsic() && !Callee->doesNotRecurse()))
+          CallsRecursive = true;
+      }
+
+      if (auto *SI = dyn_cast<StoreInst>(&I)) {
+        if (SI->isSimple() && isLocalMemory(SI->getPointerOperand(), F)) continue;
+      }
+      else if (auto *LI = dyn_cast<LoadInst>(&I)) {
+        if (LI->isSimple() && isLocalMemory(LI->getPointerOperand(), F)) continue;
+      }
+      else if (auto *RI = dyn_cast<ReturnInst>(&I)) {
+        if (RI->getReturnValue()) Returned.push_back(RI->getReturnValue());
+      }
+
+      Writes |= I.mayWriteToMemory();
+      Reads |= I.mayReadFromMemory();
+    }
+
+    if (!MayThrow) F.setDoesNotThrow();
+    if (!CallsRecursive) F.setDoesNotRecurse();
+    if (!Writes && !Reads) F.setDoesNotAccessMemory();
+    else if (!Writes) F.setOnlyReadsMemory();
+
+    if (F.getReturnType()->isPointerTy() && !Returned.empty() &&
+        all_of(Returned, isKnownNonNullReturn))
+      F.addRetAttr(Attribute::NonNull);
+  }
+
+  // Gives entry-block allocas with disjoint lifetimes (from the markers
+  // InlineFunction places around inlined bodies) one shared slot
+  static bool mergeStackSlots(Function &F) {
+    const unsigned MaxSlots = 512;
+    SmallVector<AllocaInst*, 16> Slots;
+    DenseMap<AllocaInst*, unsigned> SlotIdx;
+
+    for (Instruction &I : F.getEntryBlock()) {
+      auto *AI = dyn_cast<AllocaInst>(&I);
+      if (!AI || !AI->isStaticAlloca() || Slots.size() == MaxSlots) continue;
+
+      bool HasStart = false, HasEnd = false;
+      for (User *U : AI->users())
+        if (auto *II = dyn_cast<IntrinsicInst>(U)) {
+          HasStart |= II->getIntrinsicID() == Intrinsic::lifetime_start;
+          HasEnd |= II->getIntrinsicID() == Intrinsic::lifetime_end;
+        }
+      if (!HasStart || !HasEnd) continue;
+
+      SlotIdx[AI] = Slots.size();
+      Slots.push_back(AI);
+    }
+    if (Slots.size() < 2) return false;
+
+    unsigned N = Slots.size();
+    auto getMarker = [&](Instruction &I, bool &IsStart) -> int {
+      auto *II = dyn_cast<IntrinsicInst>(&I);
+      if (!II || !II->isLifetimeStartOrEnd()) return -1;
+      auto It = SlotIdx.find(dyn_cast<AllocaInst>(II->getArgOperand(1)));
+      if (It == SlotIdx.end()) return -1;
+      IsStart = II->getIntrinsicID() == Intrinsic::lifetime_start;
+      return It->second;
+    };
+
+    // Per block: slots whose last marker is a start, and slots with any marker
+    DenseMap<BasicBlock*, BitVector> LastStart, Touched, LiveIn, LiveOut;
+    for (BasicBlock &BB : F) {
+      BitVector Start(N), Touch(N);
+      for (Instruction &I : BB) {
+        bool IsStart;
+        int S = getMarker(I, IsStart);
+        if (S < 0) continue;
+        Touch.set(S);
+        if (IsStart) Start.set(S); else Start.reset(S);
+      }
+      LastStart[&BB] = Start;
+      Touched[&BB] = Touch;
+      LiveIn[&BB] = BitVector(N);
+      LiveOut[&BB] = BitVector(N);
+    }
+
+    // May-be-live slots at each block boundary
+    ReversePostOrderTraversal<Function*> RPOT(&F);
+    bool Changed = true;
+    while (Changed) {
+      Changed = false;
+      for (BasicBlock *BB : RPOT) {
+        BitVector In(N);
+        for (BasicBlock *Pred : predecessors(BB))
+          In |= LiveOut[Pred];
+        BitVector Out = In;
+        Out.reset(Touched[BB]);
+        Out |= LastStart[BB];
+        LiveIn[BB] = In;
+        if (Out != LiveOut[BB]) {
+          LiveOut[BB] = Out;
+          Changed = true;
+        }
+      }
+    }
+
+    // Slots conflict when they may be live at the same point; a slot used
+    // where it is not live breaks the marker contract and is left alone
+    std::vector<BitVector> Conflicts(N, BitVector(N));
+    BitVector Unsafe(N);
+    for (BasicBlock *BB : RPOT) {
+      BitVector Live = LiveIn[BB];
+      for (unsigned S : Live.set_bits())
+        Conflicts[S] |= Live;
+
+      for (Instruction &I : *BB) {
+        bool IsStart;
+        int S = getMarker(I, IsStart);
+        if (S >= 0) {
+          if (IsStart) {
+            Live.set(S);
+            for (unsigned O : Live.set_bits()) {
+              Conflicts[S].set(O);
+              Conflicts[O].set(S);
+            }
           }
+          else
+            Live.reset(S);
+          continue;
         }
+
+        for (Value *Op : I.operands()) {
+          auto It = SlotIdx.find(dyn_cast<AllocaInst>(Op));
+          if (It != SlotIdx.end() && !Live.test(It->second))
+            Unsafe.set(It->second);
+        }
+      }
+    }
+
+    // Greedily fold each slot into the first earlier one of the same type it never meets
+    SmallVector<std::pair<AllocaInst*, BitVector>, 8> Groups;
+    bool Merged = false;
+    for (unsigned S = 0; S < N; ++S) {
+      AllocaInst *AI = Slots[S];
+      if (Unsafe.test(S)) continue;
+
+      auto Group = find_if(Groups, [&](auto &G) {
+        AllocaInst *Rep = G.first;
+        return Rep->getAllocatedType() == AI->getAllocatedType() &&
+               Rep->getArraySize() == AI->getArraySize() && !G.second.anyCommon(Conflicts[S]);
+      });
+      if (Group == Groups.end()) {
+        Groups.push_back({AI, BitVector(N)});
+        Groups.back().second.set(S);
+        continue;
       }
 
-      // Erase functions that are no longer used
-      for (Function *Fn : ToErase)
-        if (Fn && Fn->use_empty()){
-          Fn->eraseFromParent();
+      AllocaInst *Rep = Group->first;
+      Rep->setAlignment(std::max(Rep->getAlign(), AI->getAlign()));
+      Group->second.set(S);
+      AI->replaceAllUsesWith(Rep);
+      AI->eraseFromParent();
+      Merged = true;
+    }
+
+    return Merged;
+  }
+
+  // Definitions brought in from -my-inline-import files, dropped again after inlining
+  std::vector<std::string> Imported;
+
+  // A copied body may not refer to anything local to its own module
+  static bool isImportable(Function &F) {
+    SmallVector<Value*, 16> Worklist;
+    SmallPtrSet<Value*, 16> Seen;
+    if (F.hasPersonalityFn())
+      Worklist.push_back(F.getPersonalityFn());
+    for (Instruction &I : instructions(F))
+      for (Value *Op : I.operands())
+        if (isa<Constant>(Op))
+          Worklist.push_back(Op);
+
+    while (!Worklist.empty()) {
+      Value *V = Worklist.pop_back_val();
+      if (!Seen.insert(V).second) continue;
+      if (auto *GV = dyn_cast<GlobalValue>(V)) {
+        if (GV->hasLocalLinkage()) return false;
+        continue;
+      }
+      if (auto *C = dyn_cast<Constant>(V))
+        for (Value *Op : C->operands())
+          Worklist.push_back(Op);
+    }
+    return true;
+  }
+
+  // Imports the bodies of the declarations M calls that some file defines as
+  // alwaysinline. The files are opened lazily, so the summary only reads their
+  // symbol tables, and a body is parsed only once it is needed.
+  bool importCallees(Module &M) {
+    LLVMContext &Ctx = M.getContext();
+    StringMap<unsigned> Index;
+    for (unsigned I = 0; I < ImportFiles.size(); ++I) {
+      SMDiagnostic Err;
+      std::unique_ptr<Module> Src = getLazyIRFileModule(ImportFiles[I], Err, Ctx);
+      if (!Src) {
+        Err.print("my-always-inline", errs());
+        continue;
+      }
+
+      for (Function &F : *Src)
+        if (!F.isDeclaration() && !F.hasLocalLinkage() && !F.isInterposable() &&
+            F.hasFnAttribute(Attribute::AlwaysInline))
+          Index.try_emplace(F.getName(), I);
+    }
+
+    // Imported bodies may call further helpers, keep going until nothing new is needed
+    bool Changed = false;
+    StringSet<> Tried;
+    while (true) {
+      std::map<unsigned, std::vector<std::string>> Needed;
+      for (Function &F : M) {
+        if (!F.isDeclaration() || F.use_empty() || Tried.count(F.getName())) continue;
+        auto It = Index.find(F.getName());
+        if (It == Index.end()) continue;
+        Tried.insert(F.getName());
+        Needed[It->second].push_back(F.getName().str());
+      }
+      if (Needed.empty()) break;
+
+      for (auto &Entry : Needed) {
+        SMDiagnostic Err;
+        std::unique_ptr<Module> Src = getLazyIRFileModule(ImportFiles[Entry.first], Err, Ctx);
+        if (!Src) continue;
+
+        std::vector<GlobalValue*> ToLink;
+        std::vector<std::string> Names;
+        for (const std::string &Name : Entry.second) {
+          Function *F = Src->getFunction(Name);
+          if (!F) continue;
+          if (Error E = F->materialize()) {
+            logAllUnhandledErrors(std::move(E), errs(), "my-always-inline: ");
+            continue;
+          }
+          if (!isImportable(*F)) continue;
+
+          // The real definition stays in its own module
+          F->setLinkage(GlobalValue::AvailableExternallyLinkage);
+          F->setComdat(nullptr);
+          ToLink.push_back(F);
+          Names.push_back(Name);
+        }
+        if (ToLink.empty()) continue;
+
+        IRMover Mover(M);
+        if (Error E = Mover.move(std::move(Src), ToLink, [](GlobalValue &, IRMover::ValueAdder) {},
+                                 /*IsPerformingImport=*/false)) {
+          logAllUnhandledErrors(std::move(E), errs(), "my-always-inline: ");
+          continue;
         }
-      // Erase attributes to make a similar output to the original always-inline
-      // Inlining might invalidate them anyway
-      if (Changed)
-      	for (Function &F : M)
-          F.setAttributes(AttributeList());
-      return Changed;
+
+        // Src is gone once moved, so keep the names rather than its functions
+        Imported.insert(Imported.end(), Names.begin(), Names.end());
+        Changed = true;
+      }
+    }
+
+    return Changed;
+  }
+
+  mypassutils::CostSummary computeCost(Function &F) {
+    return mypassutils::computeCost(F, getAnalysis<TargetTransformInfoWrapperPass>().getTTI(F),
+                                    getAnalysis<TargetLibraryInfoWrapperPass>().getTLI(F));
+  }
+
+  bool runOnModule(Module &M) override {
+    bool Changed = false;
+    SmallSetVector<Function*, 16> ToErase;
+
+    // Functions are looked up by name afterwards, inlining may erase them
+    std::vector<std::pair<std::string, mypassutils::CostSummary>> Before;
+    InlineCounts.clear();
+    if (!CostReportFile.empty())
+      for (Function &F : M)
+        if (!F.isDeclaration())
+          Before.push_back({F.getName().str(), computeCost(F)});
+
+    Imported.clear();
+    if (!ImportFiles.empty())
+      Changed |= importCallees(M);
+
+    // Walk the call graph bottom-up, so every callee is already flattened
+    // when its callers are processed, and recursion falls out of the SCCs
+    CallGraph CG(M);
+    std::vector<Function*> Order;
+    Recursive.clear();
+    Freqs.clear();
+    CallerGrowth.clear();
+    ModuleGrowth = 0;
+    Budget = mypassutils::CompileBudget("my-always-inline", {WorkBudget, TimeBudget},
+                                        {ModuleWorkBudget, ModuleTimeBudget});
+    Budget.startModule();
+    for (auto SCCI = scc_begin(&CG); !SCCI.isAtEnd(); ++SCCI) {
+      bool Cyclic = SCCI.hasCycle();
+      for (CallGraphNode *Node : *SCCI) {
+        Function *F = Node->getFunction();
+        if (!F) continue;
+        if (Cyclic) Recursive.insert(F);
+        Order.push_back(F);
+      }
+    }
+
+    for (Function *F : Order) {
+      // Skip declarations (external functions) – they can’t contain call sites we can inline.
+      if (F->isDeclaration()) continue;
+      Budget.startFunction(*F);
+      bool Inlined = !Budget.isExhausted() && inlineCallsIn(*F, ToErase);
+      bool Degraded = Budget.isDegraded();
+      Budget.finishFunction();
+      if (!Inlined) continue;
+
+      if (MergeAllocas && !Degraded)
+        mergeStackSlots(*F);
+
+      // Callers come later in the order, so they already see what we infer here
+      reinferAttributes(*F);
+      Changed = true;
+    }
+
+    // Guard clones are only templates for partial inlining
+    for (auto &Entry : PartialClones)
+      if (Entry.second && Entry.second->use_empty())
+        ToErase.insert(Entry.second);
+    PartialClones.clear();
+
+    // Erase functions that are no longer used
+    for (Function *Fn : ToErase)
+      if (Fn->use_empty())
+        Fn->eraseFromParent();
+
+    Freqs.clear();
+
+    // Imported bodies were only there to be inlined
+    for (const std::string &Name : Imported) {
+      Function *F = M.getFunction(Name);
+      if (!F || !F->hasAvailableExternallyLinkage()) continue;
+      if (F->use_empty())
+        F->eraseFromParent();
+      else
+        F->deleteBody();
+    }
+
+    for (auto &Entry : Before) {
+      Function *F = M.getFunction(Entry.first);
+      bool Alive = F && !F->isDeclaration();
+      mypassutils::CostSummary After;
+      if (Alive)
+        After = computeCost(*F);
+      mypassutils::appendCostRecord(CostReportFile, "my-always-inline", M, Entry.first, Entry.second,
+                                    Alive ? &After : nullptr, {{"inlines", Alive ? InlineCounts.lookup(F) : 0}});
+    }
+    InlineCounts.clear();
+
+    return Changed;
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<AssumptionCacheTracker>();
+    AU.addRequired<ProfileSummaryInfoWrapperPass>();
+    AU.addRequired<TargetLibraryInfoWrapperPass>();
+    AU.addRequired<TargetTransformInfoWrapperPass>();
   }
 };
 };
 
 char MyAlwaysInline::ID = 0;
 static RegisterPass<MyAlwaysInline> X("my-always-inline",
-                                      "A pass that (almost) always inlines labeled functions", false, false);
\ No newline at end of file
+                                      "A pass that (almost) always inlines labeled functions", false, false);
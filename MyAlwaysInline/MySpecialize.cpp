@@ -0,0 +1,147 @@
+#include "llvm/Pass.h"
+#include "llvm/Analysis/ConstantFolding.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/Local.h"
+
+#include <algorithm>
+
+using namespace llvm;
+
+static cl::opt<unsigned> MinCalls(
+    "my-spec-min-calls", cl::init(2),
+    cl::desc("Call sites that must share the same constant arguments before a callee is cloned for them"));
+
+static cl::opt<unsigned> MaxClones(
+    "my-spec-max-clones", cl::init(3),
+    cl::desc("Most specialized clones made of one callee"));
+
+static cl::opt<unsigned> MaxCalleeSize(
+    "my-spec-max-size", cl::init(2000),
+    cl::desc("Largest callee, in instructions, that is considered for cloning"));
+
+static cl::opt<unsigned> GrowthBudget(
+    "my-spec-budget", cl::init(10000),
+    cl::desc("Instructions all specialized clones together may add to the module"));
+
+namespace {
+struct MySpecialize : public ModulePass {
+  static char ID;
+  MySpecialize() : ModulePass(ID) {}
+
+  // Argument positions of a call that receive a constant, with that constant
+  using ConstArgs = SmallVector<std::pair<unsigned, Constant*>, 4>;
+
+  static ConstArgs getConstArgs(CallBase &CB, Function &F) {
+    ConstArgs Args;
+    for (unsigned Idx = 0; Idx < CB.arg_size(); ++Idx) {
+      Value *V = CB.getArgOperand(Idx);
+      if (!isa<ConstantInt>(V) && !isa<ConstantFP>(V) && !isa<ConstantPointerNull>(V) && !isa<GlobalValue>(V))
+        continue;
+
+      // Nothing to gain from an unused argument, and byval copies must stay copies
+      Argument *A = F.getArg(Idx);
+      if (A->use_empty() || A->hasPassPointeeByValueCopyAttr()) continue;
+      Args.push_back({Idx, cast<Constant>(V)});
+    }
+    return Args;
+  }
+
+  // Folds what the constant arguments decide: instructions, branches and the blocks they cut off
+  static void propagateConstants(Function &F) {
+    const DataLayout &DL = F.getParent()->getDataLayout();
+    bool Changed = true;
+    while (Changed) {
+      Changed = false;
+      for (BasicBlock &BB : F) {
+        for (Instruction &I : make_early_inc_range(BB)) {
+          // Some folded instructions can never be erased (ordered atomic
+          // loads), only replacing their uses is progress
+          if (!I.use_empty())
+            if (Constant *C = ConstantFoldInstruction(&I, DL)) {
+              I.replaceAllUsesWith(C);
+              Changed = true;
+            }
+          if (isInstructionTriviallyDead(&I)) {
+            I.eraseFromParent();
+            Changed = true;
+          }
+        }
+        Changed |= ConstantFoldTerminator(&BB, true);
+      }
+      Changed |= removeUnreachableBlocks(F);
+    }
+  }
+
+  static Function *specialize(Function &F, const ConstArgs &Args) {
+    ValueToValueMapTy VMap;
+    Function *Clone = CloneFunction(&F, VMap);
+    Clone->setName(F.getName() + ".spec");
+    Clone->setLinkage(GlobalValue::InternalLinkage);
+    Clone->setComdat(nullptr);
+
+    for (auto &[Idx, C] : Args)
+      Clone->getArg(Idx)->replaceAllUsesWith(C);
+    propagateConstants(*Clone);
+    return Clone;
+  }
+
+  bool runOnModule(Module &M) override {
+    bool Changed = false;
+    unsigned Growth = 0;
+
+    std::vector<Function*> Candidates;
+    for (Function &F : M)
+      if (!F.isDeclaration() && !F.isInterposable() && !F.isVarArg() && !F.hasFnAttribute(Attribute::OptimizeNone) &&
+          F.getInstructionCount() <= MaxCalleeSize)
+        Candidates.push_back(&F);
+
+    for (Function *F : Candidates) {
+      // Group the direct calls by the constants they pass
+      std::vector<std::pair<ConstArgs, SmallVector<CallBase*, 4>>> Groups;
+      for (User *U : F->users()) {
+        auto *CB = dyn_cast<CallBase>(U);
+        if (!CB || CB->getCalledFunction() != F || CB->getCaller() == F) continue;
+
+        ConstArgs Args = getConstArgs(*CB, *F);
+        if (Args.empty()) continue;
+
+        auto It = std::find_if(Groups.begin(), Groups.end(), [&](auto &G) { return G.first == Args; });
+        if (It == Groups.end())
+          Groups.push_back({Args, {CB}});
+        else
+          It->second.push_back(CB);
+      }
+
+      std::stable_sort(Groups.begin(), Groups.end(),
+                       [](auto &A, auto &B) { return A.second.size() > B.second.size(); });
+
+      unsigned Clones = 0;
+      for (auto &[Args, Calls] : Groups) {
+        if (Calls.size() < MinCalls || Clones >= MaxClones) break;
+        if (Growth + F->getInstructionCount() > GrowthBudget) break;
+
+        Function *Clone = specialize(*F, Args);
+        Growth += Clone->getInstructionCount();
+        for (CallBase *CB : Calls)
+          CB->setCalledFunction(Clone);
+        ++Clones;
+        Changed = true;
+      }
+
+      if (Clones && F->use_empty() && F->hasLocalLinkage())
+        F->eraseFromParent();
+    }
+
+    return Changed;
+  }
+};
+};
+
+char MySpecialize::ID = 0;
+static RegisterPass<MySpecialize> X("my-specialize",
+                                    "Clones callees for frequently passed constant arguments", false, false);
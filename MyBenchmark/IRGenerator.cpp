@@ -0,0 +1,208 @@
+#include "IRGenerator.h"
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+
+#include <random>
+
+using namespace llvm;
+
+namespace {
+// Builds @loops(ptr %a, ptr %b, i32 %n, i32 %k): loop nests one after another,
+// every level with if/else diamonds that recompute values invariant in %k
+struct LoopsBuilder {
+  const IRGenOptions &Opts;
+  LLVMContext &Ctx;
+  Function *F;
+  IRBuilder<> B;
+  Value *A, *Out, *N, *K;
+  unsigned Salt = 0;
+
+  LoopsBuilder(Module &M, const IRGenOptions &Opts)
+      : Opts(Opts), Ctx(M.getContext()), B(M.getContext()) {
+    Type *I32 = B.getInt32Ty();
+    PointerType *Ptr = PointerType::get(Ctx, 0);
+    FunctionType *FTy = FunctionType::get(B.getVoidTy(), {Ptr, Ptr, I32, I32}, false);
+    F = Function::Create(FTy, GlobalValue::ExternalLinkage, "loops", M);
+    A = F->getArg(0);
+    Out = F->getArg(1);
+    N = F->getArg(2);
+    K = F->getArg(3);
+    A->setName("a");
+    Out->setName("b");
+    N->setName("n");
+    K->setName("k");
+  }
+
+  // Leaves the builder at the start of the join block
+  void emitDiamond(Value *Idx) {
+    unsigned C = Salt++;
+    BasicBlock *Then = BasicBlock::Create(Ctx, "then", F);
+    BasicBlock *Else = BasicBlock::Create(Ctx, "else", F);
+    BasicBlock *Join = BasicBlock::Create(Ctx, "join", F);
+
+    Value *Inv = B.CreateMul(K, B.getInt32(C + 3), "inv");
+    Value *Inv2 = B.CreateAdd(Inv, N, "inv2");
+    Value *V = B.CreateLoad(B.getInt32Ty(), B.CreateGEP(B.getInt32Ty(), A, Idx), "v");
+    Value *T = B.CreateAdd(V, Inv2, "t");
+    B.CreateCondBr(B.CreateICmpSGT(T, B.getInt32(C)), Then, Else);
+
+    B.SetInsertPoint(Then);
+    B.CreateStore(T, B.CreateGEP(B.getInt32Ty(), Out, Idx));
+    B.CreateBr(Join);
+
+    B.SetInsertPoint(Else);
+    B.CreateStore(B.CreateShl(T, 1), B.CreateGEP(B.getInt32Ty(), Out, Idx));
+    B.CreateBr(Join);
+
+    B.SetInsertPoint(Join);
+  }
+
+  // Loops as clang emits them at -O0, which is the form my-licm expects: the
+  // counter lives in a stack slot and the header tests it before the body runs
+  void emitNest(unsigned Depth, Value *OuterIdx) {
+    BasicBlock &Entry = F->getEntryBlock();
+    Value *Counter = IRBuilder<>(&Entry, Entry.begin()).CreateAlloca(B.getInt32Ty(), nullptr, "i.addr");
+    BasicBlock *Cond = BasicBlock::Create(Ctx, "for.cond", F);
+    BasicBlock *Body = BasicBlock::Create(Ctx, "for.body", F);
+    BasicBlock *Inc = BasicBlock::Create(Ctx, "for.inc", F);
+    BasicBlock *End = BasicBlock::Create(Ctx, "for.end", F);
+    B.CreateStore(B.getInt32(0), Counter);
+    B.CreateBr(Cond);
+
+    B.SetInsertPoint(Cond);
+    Value *I = B.CreateLoad(B.getInt32Ty(), Counter, "i");
+    B.CreateCondBr(B.CreateICmpSLT(I, N), Body, End);
+
+    B.SetInsertPoint(Body);
+    Value *Idx = B.CreateLoad(B.getInt32Ty(), Counter, "i");
+    if (OuterIdx)
+      Idx = B.CreateAdd(Idx, OuterIdx, "idx");
+    for (unsigned D = 0; D < Opts.LoopBlocks; ++D)
+      emitDiamond(Idx);
+    if (Depth > 1)
+      emitNest(Depth - 1, Idx);
+    B.CreateBr(Inc);
+
+    B.SetInsertPoint(Inc);
+    Value *Next = B.CreateAdd(B.CreateLoad(B.getInt32Ty(), Counter, "i"), B.getInt32(1), "inc");
+    B.CreateStore(Next, Counter);
+    B.CreateBr(Cond);
+
+    B.SetInsertPoint(End);
+  }
+
+  uint64_t build() {
+    B.SetInsertPoint(BasicBlock::Create(Ctx, "entry", F));
+    unsigned Depth = std::max(1u, Opts.LoopDepth);
+    uint64_t PerNest = Depth * (13 + 14 * uint64_t(Opts.LoopBlocks));
+    uint64_t Nests = std::max<uint64_t>(1, Opts.Size / PerNest);
+    for (uint64_t I = 0; I < Nests; ++I)
+      emitNest(Depth, nullptr);
+    B.CreateRetVoid();
+    return F->getInstructionCount();
+  }
+};
+} // namespace
+
+// @chain(i32 %x, i32 %y): each instruction combines two of the last few values,
+// often with an identity or a power of two InstCombine can fold
+static uint64_t generateChain(Module &M, const IRGenOptions &Opts) {
+  IRBuilder<> B(M.getContext());
+  FunctionType *FTy = FunctionType::get(B.getInt32Ty(), {B.getInt32Ty(), B.getInt32Ty()}, false);
+  Function *F = Function::Create(FTy, GlobalValue::ExternalLinkage, "chain", M);
+  F->getArg(0)->setName("x");
+  F->getArg(1)->setName("y");
+  B.SetInsertPoint(BasicBlock::Create(M.getContext(), "entry", F));
+
+  std::mt19937 RNG(Opts.Seed);
+  SmallVector<Value*, 8> Recent = {F->getArg(0), F->getArg(1)};
+  Value *Last = F->getArg(0);
+  for (uint64_t I = 1; I < Opts.Size; ++I) {
+    Value *L = Recent[RNG() % Recent.size()];
+    Value *R = Recent[RNG() % Recent.size()];
+    switch (RNG() % 10) {
+    case 0: Last = B.CreateAdd(L, B.getInt32(0)); break;
+    case 1: Last = B.CreateMul(L, B.getInt32(8)); break;
+    case 2: Last = B.CreateSub(L, R); break;
+    case 3: Last = B.CreateXor(L, R); break;
+    case 4: Last = B.CreateShl(L, 1); break;
+    case 5: Last = B.CreateAnd(L, B.getInt32(-1)); break;
+    case 6: Last = B.CreateUDiv(L, B.getInt32(4)); break;
+    case 7: Last = B.CreateAdd(L, R); break;
+    case 8: Last = B.CreateMul(L, R); break;
+    default: Last = B.CreateOr(L, B.getInt32(0)); break;
+    }
+
+    if (Recent.size() == 8)
+      Recent.erase(Recent.begin());
+    Recent.push_back(Last);
+  }
+  B.CreateRet(Last);
+  return F->getInstructionCount();
+}
+
+// @node0 calls @node1 Fanout times, and so on down to the leaves; every node
+// below the root is internal and alwaysinline, so inlining flattens the tree
+static uint64_t generateInlineTree(Module &M, const IRGenOptions &Opts) {
+  uint64_t Fanout = std::max(1u, Opts.Fanout);
+
+  // Instructions of the root once everything below level L is inlined into it
+  auto flattenedSize = [&](unsigned Levels) {
+    uint64_t Size = 3;
+    for (unsigned L = 0; L < Levels; ++L)
+      Size = (3 + 3 * Fanout) - Fanout + Fanout * (Size - 1);
+    return Size;
+  };
+  unsigned Levels = 0;
+  while (flattenedSize(Levels) < Opts.Size && Levels < 64)
+    ++Levels;
+
+  IRBuilder<> B(M.getContext());
+  FunctionType *FTy = FunctionType::get(B.getInt32Ty(), {B.getInt32Ty()}, false);
+  std::vector<Function*> Nodes;
+  for (unsigned L = 0; L <= Levels; ++L) {
+    Function *F = Function::Create(FTy, L ? GlobalValue::InternalLinkage : GlobalValue::ExternalLinkage,
+                                   "node" + Twine(L), M);
+    if (L) F->addFnAttr(Attribute::AlwaysInline);
+    Nodes.push_back(F);
+  }
+
+  for (unsigned L = 0; L <= Levels; ++L) {
+    Function *F = Nodes[L];
+    B.SetInsertPoint(BasicBlock::Create(M.getContext(), "entry", F));
+    Value *Acc = B.CreateAdd(B.CreateMul(F->getArg(0), B.getInt32(L + 3)), B.getInt32(L));
+    if (L < Levels)
+      for (uint64_t J = 0; J < Fanout; ++J) {
+        Value *Arg = B.CreateAdd(Acc, B.getInt32(J));
+        Acc = B.CreateAdd(Acc, B.CreateCall(Nodes[L + 1], {Arg}));
+      }
+    B.CreateRet(Acc);
+  }
+  return flattenedSize(Levels);
+}
+
+std::unique_ptr<Module> generateIR(LLVMContext &Ctx, const IRGenOptions &Opts, uint64_t &Instructions) {
+  auto M = std::make_unique<Module>(getShapeName(Opts.Shape), Ctx);
+  switch (Opts.Shape) {
+  case IRShape::Loops:
+    Instructions = LoopsBuilder(*M, Opts).build();
+    break;
+  case IRShape::Chain:
+    Instructions = generateChain(*M, Opts);
+    break;
+  case IRShape::InlineTree:
+    Instructions = generateInlineTree(*M, Opts);
+    break;
+  }
+  return M;
+}
+
+const char *getShapeName(IRShape Shape) {
+  switch (Shape) {
+  case IRShape::Loops: return "loops";
+  case IRShape::Chain: return "chain";
+  case IRShape::InlineTree: return "inline";
+  }
+  return "unknown";
+}
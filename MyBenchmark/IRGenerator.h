@@ -0,0 +1,35 @@
+// Synthetic inputs for the compile-time benchmarks. Every shape grows a single
+// function (or a single call tree), so costs that are superlinear in function
+// size show up as the size parameter grows.
+
+#ifndef MY_BENCHMARK_IR_GENERATOR_H
+#define MY_BENCHMARK_IR_GENERATOR_H
+
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+
+#include <memory>
+
+enum class IRShape {
+  Loops,      // sequential loop nests with branchy bodies and invariant arithmetic
+  Chain,      // one long straight-line arithmetic chain full of foldable patterns
+  InlineTree  // a tree of alwaysinline calls that flattens into one function
+};
+
+struct IRGenOptions {
+  IRShape Shape = IRShape::Loops;
+  uint64_t Size = 1000;       // instructions the passes should see
+  unsigned LoopDepth = 3;     // nesting depth of each loop nest
+  unsigned LoopBlocks = 4;    // if/else diamonds in the body of every loop level
+  unsigned Fanout = 2;        // calls per node of the inline tree
+  unsigned Seed = 1;
+};
+
+// Returns the module, and in Instructions the size of the function the
+// passes end up working on (after inlining, for InlineTree)
+std::unique_ptr<llvm::Module> generateIR(llvm::LLVMContext &Ctx, const IRGenOptions &Opts,
+                                         uint64_t &Instructions);
+
+const char *getShapeName(IRShape Shape);
+
+#endif
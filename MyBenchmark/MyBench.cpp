@@ -0,0 +1,320 @@
+// my-bench: compile-time scaling of the plugin passes against their upstream
+// counterparts. For every shape and size it generates an input, runs each pass
+// in its own opt process and records wall time, CPU time and peak RSS; then it
+// fits time ~ instructions^k per shape and pass, where k near 1 is linear and
+// k near 2 points at a quadratic path.
+//
+//   my-bench --opt=build/bin/opt --load=build/lib/MyAlwaysInline.so
+//            --load=build/lib/MyInstCombine.so --load=build/lib/LLVMMyLICMPass.so
+//            --sizes=100,1000,10000 --format=json -o bench.json
+
+#include "IRGenerator.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/WithColor.h"
+
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <optional>
+
+using namespace llvm;
+
+static cl::opt<std::string> OptPath("opt", cl::desc("opt to run the passes with (default: next to my-bench, then PATH)"));
+
+static cl::list<std::string> Plugins("load", cl::desc("Plugin opt loads for the my-* passes"),
+                                     cl::value_desc("plugin"));
+
+static cl::opt<std::string> LegacyPMFlag(
+    "legacy-pm-flag", cl::init("--bugpoint-enable-legacy-pm"),
+    cl::desc("Flag opt needs to run legacy plugin passes, empty for none"));
+
+static cl::list<std::string> Shapes("shapes", cl::CommaSeparated,
+                                    cl::desc("Input shapes (default: loops,chain,inline)"));
+
+static cl::list<std::string> Passes(
+    "passes", cl::CommaSeparated,
+    cl::desc("Passes to time (default: my-licm,licm,my-inst-combine,instcombine,my-always-inline,always-inline)"));
+
+static cl::list<uint64_t> Sizes("sizes", cl::CommaSeparated,
+                                cl::desc("Input sizes in instructions (default: 100,...,1000000)"));
+
+static cl::opt<unsigned> LoopDepth("loop-depth", cl::init(3), cl::desc("Nesting depth of each loop nest"));
+
+static cl::opt<unsigned> LoopBlocks("loop-blocks", cl::init(4), cl::desc("If/else diamonds per loop level"));
+
+static cl::opt<unsigned> Fanout("fanout", cl::init(2), cl::desc("Calls per node of the inline tree"));
+
+static cl::opt<unsigned> Repeat("repeat", cl::init(3), cl::desc("Runs per measurement, the fastest one counts"));
+
+static cl::opt<unsigned> Timeout("timeout", cl::init(60),
+                                 cl::desc("Seconds a single run may take; larger sizes of that pass are skipped"));
+
+static cl::opt<double> MinFitSeconds("min-fit-seconds", cl::init(0.05),
+                                     cl::desc("Faster runs are dominated by startup and left out of the fit"));
+
+enum class Format { CSV, JSON };
+static cl::opt<Format> OutputFormat(
+    "format", cl::init(Format::CSV), cl::desc("Report format"),
+    cl::values(clEnumValN(Format::CSV, "csv", "Runs, then the fitted exponents"),
+               clEnumValN(Format::JSON, "json", "One object with runs and scaling")));
+
+static cl::opt<std::string> OutputFilename("o", cl::desc("Report filename"), cl::init("-"),
+                                           cl::value_desc("filename"));
+
+static cl::opt<bool> KeepInputs("keep-inputs", cl::desc("Keep the generated inputs in the work directory"));
+
+namespace {
+struct Run {
+  std::string Shape, Pass;
+  uint64_t Size, Instructions;
+  double Seconds = 0, CPUSeconds = 0;
+  uint64_t PeakRSSKB = 0;
+  std::string Status = "ok";
+};
+
+struct Fit {
+  std::string Shape, Pass;
+  double Exponent;
+  unsigned Points;
+};
+} // namespace
+
+// Runs once per Repeat and keeps the fastest run and the largest RSS
+static Run measure(StringRef Opt, StringRef Pass, StringRef Input) {
+  std::vector<std::string> Args = {Opt.str()};
+  if (Pass.starts_with("my-")) {
+    for (const std::string &P : Plugins) {
+      Args.push_back("-load");
+      Args.push_back(P);
+    }
+    if (!LegacyPMFlag.empty())
+      Args.push_back(LegacyPMFlag);
+    Args.push_back("-" + Pass.str());
+  }
+  else
+    Args.push_back("-passes=" + Pass.str());
+  Args.push_back("-disable-output");
+  Args.push_back(Input.str());
+  std::vector<StringRef> ArgRefs(Args.begin(), Args.end());
+
+  // The plugin passes print what they did, which is not what is measured here
+  std::optional<StringRef> Redirects[] = {StringRef(""), StringRef(""), StringRef("")};
+
+  Run Best;
+  for (unsigned I = 0; I < std::max(1u, Repeat.getValue()); ++I) {
+    std::optional<sys::ProcessStatistics> Stats;
+    std::string ErrMsg;
+    auto Start = std::chrono::steady_clock::now();
+    int RC = sys::ExecuteAndWait(Opt, ArgRefs, std::nullopt, Redirects, Timeout, 0, &ErrMsg, nullptr, &Stats);
+    double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+
+    if (RC != 0) {
+      Best.Status = RC == -2 && Seconds >= Timeout ? "timeout" : "failed";
+      Best.Seconds = Seconds;
+      return Best;
+    }
+    if (I == 0 || Seconds < Best.Seconds) {
+      Best.Seconds = Seconds;
+      if (Stats)
+        Best.CPUSeconds = std::chrono::duration<double>(Stats->TotalTime).count();
+    }
+    if (Stats)
+      Best.PeakRSSKB = std::max(Best.PeakRSSKB, Stats->PeakMemory);
+  }
+  return Best;
+}
+
+// Least-squares slope of log(seconds) over log(instructions)
+static std::vector<Fit> fitExponents(const std::vector<Run> &Runs) {
+  std::vector<Fit> Fits;
+  std::map<std::pair<std::string, std::string>, std::vector<std::pair<double, double>>> Points;
+  std::vector<std::pair<std::string, std::string>> Order;
+  for (const Run &R : Runs) {
+    auto Key = std::make_pair(R.Shape, R.Pass);
+    if (!Points.count(Key)) Order.push_back(Key);
+    auto &P = Points[Key];
+    if (R.Status == "ok" && R.Seconds >= MinFitSeconds && R.Instructions)
+      P.push_back({std::log(double(R.Instructions)), std::log(R.Seconds)});
+  }
+
+  for (auto &Key : Order) {
+    auto &P = Points[Key];
+    if (P.size() < 2) continue;
+    double MeanX = 0, MeanY = 0;
+    for (auto &XY : P) {
+      MeanX += XY.first / P.size();
+      MeanY += XY.second / P.size();
+    }
+    double Cov = 0, Var = 0;
+    for (auto &XY : P) {
+      Cov += (XY.first - MeanX) * (XY.second - MeanY);
+      Var += (XY.first - MeanX) * (XY.first - MeanX);
+    }
+    if (Var > 0)
+      Fits.push_back({Key.first, Key.second, Cov / Var, unsigned(P.size())});
+  }
+  return Fits;
+}
+
+static void writeCSV(raw_ostream &OS, const std::vector<Run> &Runs, const std::vector<Fit> &Fits) {
+  OS << "shape,pass,size,instructions,seconds,cpu_seconds,peak_rss_kb,status\n";
+  for (const Run &R : Runs)
+    OS << R.Shape << ',' << R.Pass << ',' << R.Size << ',' << R.Instructions << ','
+       << format("%.6f", R.Seconds) << ',' << format("%.6f", R.CPUSeconds) << ',' << R.PeakRSSKB << ','
+       << R.Status << '\n';
+
+  OS << "\nshape,pass,exponent,points\n";
+  for (const Fit &F : Fits)
+    OS << F.Shape << ',' << F.Pass << ',' << format("%.3f", F.Exponent) << ',' << F.Points << '\n';
+}
+
+static void writeJSON(raw_ostream &OS, const std::vector<Run> &Runs, const std::vector<Fit> &Fits) {
+  json::OStream J(OS, 2);
+  J.object([&] {
+    J.attributeArray("runs", [&] {
+      for (const Run &R : Runs)
+        J.object([&] {
+          J.attribute("shape", R.Shape);
+          J.attribute("pass", R.Pass);
+          J.attribute("size", int64_t(R.Size));
+          J.attribute("instructions", int64_t(R.Instructions));
+          J.attribute("seconds", R.Seconds);
+          J.attribute("cpu_seconds", R.CPUSeconds);
+          J.attribute("peak_rss_kb", int64_t(R.PeakRSSKB));
+          J.attribute("status", R.Status);
+        });
+    });
+    J.attributeArray("scaling", [&] {
+      for (const Fit &F : Fits)
+        J.object([&] {
+          J.attribute("shape", F.Shape);
+          J.attribute("pass", F.Pass);
+          J.attribute("exponent", F.Exponent);
+          J.attribute("points", int64_t(F.Points));
+        });
+    });
+  });
+  OS << '\n';
+}
+
+int main(int argc, char **argv) {
+  InitLLVM X(argc, argv);
+  cl::ParseCommandLineOptions(argc, argv, "compile-time scaling benchmark for the My* passes\n");
+
+  std::string Opt = OptPath;
+  if (Opt.empty()) {
+    SmallString<256> Sibling(sys::path::parent_path(sys::fs::getMainExecutable(argv[0], (void *)&main)));
+    sys::path::append(Sibling, "opt");
+    if (sys::fs::can_execute(Sibling))
+      Opt = std::string(Sibling);
+    else if (ErrorOr<std::string> Found = sys::findProgramByName("opt"))
+      Opt = *Found;
+    else {
+      WithColor::error(errs(), argv[0]) << "cannot find opt, pass --opt\n";
+      return 1;
+    }
+  }
+
+  std::vector<std::string> ShapeNames(Shapes.begin(), Shapes.end());
+  if (ShapeNames.empty())
+    ShapeNames = {"loops", "chain", "inline"};
+  std::vector<std::string> PassNames(Passes.begin(), Passes.end());
+  if (PassNames.empty())
+    PassNames = {"my-licm", "licm", "my-inst-combine", "instcombine", "my-always-inline", "always-inline"};
+  std::vector<uint64_t> SizeList(Sizes.begin(), Sizes.end());
+  if (SizeList.empty())
+    SizeList = {100, 1000, 10000, 100000, 1000000};
+
+  SmallString<128> WorkDir;
+  if (std::error_code EC = sys::fs::createUniqueDirectory("my-bench", WorkDir)) {
+    WithColor::error(errs(), argv[0]) << EC.message() << '\n';
+    return 1;
+  }
+
+  std::vector<Run> Runs;
+  for (const std::string &ShapeName : ShapeNames) {
+    IRGenOptions Opts;
+    if (ShapeName == "loops") Opts.Shape = IRShape::Loops;
+    else if (ShapeName == "chain") Opts.Shape = IRShape::Chain;
+    else if (ShapeName == "inline") Opts.Shape = IRShape::InlineTree;
+    else {
+      WithColor::error(errs(), argv[0]) << "unknown shape '" << ShapeName << "'\n";
+      return 1;
+    }
+    Opts.LoopDepth = LoopDepth;
+    Opts.LoopBlocks = LoopBlocks;
+    Opts.Fanout = Fanout;
+
+    // Once a pass times out on this shape, larger inputs would only time out too
+    StringSet<> GaveUp;
+    for (uint64_t Size : SizeList) {
+      Opts.Size = Size;
+      LLVMContext Context;
+      uint64_t Instructions;
+      std::unique_ptr<Module> M = generateIR(Context, Opts, Instructions);
+
+      SmallString<128> Input(WorkDir);
+      sys::path::append(Input, ShapeName + "-" + std::to_string(Size) + ".bc");
+      std::error_code EC;
+      {
+        ToolOutputFile Out(Input, EC, sys::fs::OF_None);
+        if (EC) {
+          WithColor::error(errs(), argv[0]) << EC.message() << '\n';
+          return 1;
+        }
+        WriteBitcodeToFile(*M, Out.os());
+        Out.keep();
+      }
+
+      for (const std::string &Pass : PassNames) {
+        Run R;
+        if (GaveUp.count(Pass))
+          R.Status = "skipped";
+        else
+          R = measure(Opt, Pass, Input);
+        R.Shape = ShapeName;
+        R.Pass = Pass;
+        R.Size = Size;
+        R.Instructions = Instructions;
+        if (R.Status == "timeout")
+          GaveUp.insert(Pass);
+
+        errs() << ShapeName << ' ' << Pass << ' ' << Instructions << ": " << R.Status;
+        if (R.Status == "ok")
+          errs() << ' ' << format("%.3f", R.Seconds) << "s " << R.PeakRSSKB << "KB";
+        errs() << '\n';
+        Runs.push_back(R);
+      }
+
+      if (!KeepInputs)
+        sys::fs::remove(Input);
+    }
+  }
+  if (!KeepInputs)
+    sys::fs::remove(WorkDir);
+
+  std::error_code EC;
+  ToolOutputFile Out(OutputFilename, EC, sys::fs::OF_TextWithCRLF);
+  if (EC) {
+    WithColor::error(errs(), argv[0]) << EC.message() << '\n';
+    return 1;
+  }
+  std::vector<Fit> Fits = fitExponents(Runs);
+  if (OutputFormat == Format::JSON)
+    writeJSON(Out.os(), Runs, Fits);
+  else
+    writeCSV(Out.os(), Runs, Fits);
+  Out.keep();
+  return 0;
+}
@@ -0,0 +1,72 @@
+// my-ir-gen: writes one synthetic benchmark input, e.g.
+//
+//   my-ir-gen --shape=loops --size=100000 --loop-depth=3 --loop-blocks=4 -o loops.bc
+
+#include "IRGenerator.h"
+
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/WithColor.h"
+
+using namespace llvm;
+
+static cl::opt<IRShape> Shape(
+    "shape", cl::desc("Kind of code to generate"), cl::init(IRShape::Loops),
+    cl::values(clEnumValN(IRShape::Loops, "loops", "Loop nests with invariant code"),
+               clEnumValN(IRShape::Chain, "chain", "A straight-line arithmetic chain"),
+               clEnumValN(IRShape::InlineTree, "inline", "A tree of alwaysinline calls")));
+
+static cl::opt<uint64_t> Size("size", cl::init(1000), cl::desc("Instructions the passes should see"));
+
+static cl::opt<unsigned> LoopDepth("loop-depth", cl::init(3), cl::desc("Nesting depth of each loop nest"));
+
+static cl::opt<unsigned> LoopBlocks("loop-blocks", cl::init(4), cl::desc("If/else diamonds per loop level"));
+
+static cl::opt<unsigned> Fanout("fanout", cl::init(2), cl::desc("Calls per node of the inline tree"));
+
+static cl::opt<unsigned> Seed("seed", cl::init(1), cl::desc("Seed for the chain shape"));
+
+static cl::opt<std::string> OutputFilename("o", cl::desc("Output filename"), cl::init("-"),
+                                           cl::value_desc("filename"));
+
+static cl::opt<bool> OutputAssembly("S", cl::desc("Write textual IR instead of bitcode"));
+
+int main(int argc, char **argv) {
+  InitLLVM X(argc, argv);
+  cl::ParseCommandLineOptions(argc, argv, "synthetic IR generator for the pass benchmarks\n");
+
+  IRGenOptions Opts;
+  Opts.Shape = Shape;
+  Opts.Size = Size;
+  Opts.LoopDepth = LoopDepth;
+  Opts.LoopBlocks = LoopBlocks;
+  Opts.Fanout = Fanout;
+  Opts.Seed = Seed;
+
+  LLVMContext Context;
+  uint64_t Instructions;
+  std::unique_ptr<Module> M = generateIR(Context, Opts, Instructions);
+  if (verifyModule(*M, &errs())) {
+    WithColor::error(errs(), argv[0]) << "generated a broken module\n";
+    return 1;
+  }
+
+  std::error_code EC;
+  ToolOutputFile Out(OutputFilename, EC, OutputAssembly ? sys::fs::OF_TextWithCRLF : sys::fs::OF_None);
+  if (EC) {
+    WithColor::error(errs(), argv[0]) << EC.message() << '\n';
+    return 1;
+  }
+  if (OutputAssembly)
+    M->print(Out.os(), nullptr);
+  else
+    WriteBitcodeToFile(*M, Out.os());
+  Out.keep();
+
+  errs() << getShapeName(Shape) << ": " << Instructions << " instructions\n";
+  return 0;
+}
@@ -1,12 +1,52 @@
 #include "llvm/Pass.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/ConstantFolding.h"
+#include "llvm/Analysis/MemoryLocation.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/ConstantRange.h"
+#include "llvm/IR/Dominators.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Intrinsics.h"
 #include "llvm/IR/PatternMatch.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/KnownBits.h"
+#include "llvm/Transforms/Utils/Local.h"
 
 #include <algorithm>
 
+#include "CompileBudget.h"
+#include "CostReport.h"
+
 using namespace llvm;
 using namespace llvm::PatternMatch;
 
+static cl::opt<std::string> CostReportFile(
+    "my-inst-combine-cost-report", cl::value_desc("filename"),
+    cl::desc("Append the TTI cost of every function before and after my-inst-combine to this file as JSON lines"));
+
+static cl::opt<unsigned> MaxIterations(
+    "my-inst-combine-max-iterations", cl::init(100),
+    cl::desc("Most passes over a function before my-inst-combine stops looking for a fixpoint"));
+
+static cl::opt<uint64_t> WorkBudget(
+    "my-inst-combine-work-budget", cl::init(0),
+    cl::desc("Instructions my-inst-combine may visit in one function before it degrades (0: no limit)"));
+
+static cl::opt<uint64_t> TimeBudget(
+    "my-inst-combine-time-budget-ms", cl::init(0),
+    cl::desc("Milliseconds my-inst-combine may spend on one function before it degrades (0: no limit)"));
+
+static cl::opt<uint64_t> ModuleWorkBudget(
+    "my-inst-combine-module-work-budget", cl::init(0),
+    cl::desc("Instructions my-inst-combine may visit in the whole module before it degrades (0: no limit; not with my-opt -j or -cache-dir)"));
+
+static cl::opt<uint64_t> ModuleTimeBudget(
+    "my-inst-combine-module-time-budget-ms", cl::init(0),
+    cl::desc("Milliseconds my-inst-combine may spend on the whole module before it degrades (0: no limit; not with my-opt -j or -cache-dir)"));
+
 namespace {
 
 struct MyInstCombine : public FunctionPass {
@@ -14,6 +54,15 @@ struct MyInstCombine : public FunctionPass {
   static char ID;
   MyInstCombine() : FunctionPass(ID) {}
 
+  DominatorTree *DT = nullptr;
+  AAResults *AA = nullptr;
+
+  // Over budget, the folds that need DT, AA or known bits are skipped
+  mypassutils::CompileBudget Budget{"my-inst-combine", {}, {}};
+
+  // How far the in-block memory folds look for a matching access
+  static const unsigned MaxMemScan = 32;
+
   static bool replaceInst(Instruction &I, Value *V) 
   {
     if (V == &I) return false; 
@@ -153,16 +202,6 @@ struct MyInstCombine : public FunctionPass {
 
   static bool foldNegations(Instruction &I) 
   {
-    if (I.getOpcode() == Instruction::Sub) 
-    {
-      Value *X = nullptr;
-      if (match(&I, m_Sub(m_Zero(), m_Value(X)))) 
-      {
-        IRBuilder<> B(&I);
-        return replaceInst(I, B.CreateNeg(X, "neg"));
-      }
-    }
-
     if (I.getOpcode() == Instruction::Add) 
     {
       Value *X = nullptr, *Y = nullptr;
@@ -255,13 +294,419 @@ struct MyInstCombine : public FunctionPass {
     } 
     else 
     {
-      if (C->isNegative()) return false;
+      // sdiv rounds towards zero, ashr towards -inf, so X must not be negative
+      if (C->isNegative() || !getKnownBits(X, I).isNonNegative()) return false;
       Result = B.CreateAShr(X, ShiftAmt, "sdiv2k");
     }
     
     return replaceInst(I, Result);
   }
 
+  static bool foldRemPow2ToAnd(Instruction &I) 
+  {
+    auto *BO = dyn_cast<BinaryOperator>(&I);
+    if (!BO) return false;
+
+    unsigned Opcode = BO->getOpcode();
+    if (Opcode != Instruction::URem && Opcode != Instruction::SRem) return false;
+
+    Value *X = nullptr; ConstantInt *C = nullptr;
+    if (!match(BO, m_BinOp(m_Value(X), m_ConstantInt(C)))) return false;
+
+    if (!C->getValue().isPowerOf2()) return false;
+
+    // srem keeps the sign of X, so the mask is only valid for non-negative X
+    if (Opcode == Instruction::SRem && !getKnownBits(X, I).isNonNegative()) return false;
+
+    IRBuilder<> B(&I);
+    Value *Mask = ConstantInt::get(X->getType(), C->getValue() - 1);
+    return replaceInst(I, B.CreateAnd(X, Mask, "rem2k"));
+  }
+
+  static KnownBits getKnownBits(Value *V, const Instruction &CxtI) 
+  {
+    return computeKnownBits(V, CxtI.getModule()->getDataLayout());
+  }
+
+  // Returns a simpler value that agrees with V on every Demanded bit, or nullptr
+  static Value *simplifyDemandedBits(Value *V, const APInt &Demanded, const Instruction &CxtI) 
+  {
+    if (!V->getType()->isIntegerTy() || isa<Constant>(V)) return nullptr;
+
+    KnownBits Known = getKnownBits(V, CxtI);
+    if (Demanded.isSubsetOf(Known.Zero | Known.One))
+      return ConstantInt::get(V->getType(), Known.One);
+
+    auto *I = dyn_cast<Instruction>(V);
+    if (!I) return nullptr;
+
+    Value *X = nullptr;
+    switch (I->getOpcode()) 
+    {
+    case Instruction::Or:
+    case Instruction::Xor:
+      // An operand that is zero on every demanded bit does not contribute
+      for (unsigned Idx = 0; Idx < 2; ++Idx)
+        if (Demanded.isSubsetOf(getKnownBits(I->getOperand(Idx), CxtI).Zero))
+          return I->getOperand(1 - Idx);
+      break;
+
+    case Instruction::And:
+      for (unsigned Idx = 0; Idx < 2; ++Idx)
+        if (Demanded.isSubsetOf(getKnownBits(I->getOperand(Idx), CxtI).One))
+          return I->getOperand(1 - Idx);
+      break;
+
+    case Instruction::Add: 
+    {
+      // Carries only move upwards, so only bits up to the highest demanded one matter
+      APInt Low = APInt::getLowBitsSet(Demanded.getBitWidth(), Demanded.getActiveBits());
+      for (unsigned Idx = 0; Idx < 2; ++Idx)
+        if (Low.isSubsetOf(getKnownBits(I->getOperand(Idx), CxtI).Zero))
+          return I->getOperand(1 - Idx);
+      break;
+    }
+
+    case Instruction::ZExt:
+    case Instruction::SExt:
+      // ext (trunc X) is X again on the bits the trunc kept
+      if (match(I->getOperand(0), m_Trunc(m_Value(X))) && X->getType() == V->getType() &&
+          Demanded.getActiveBits() <= I->getOperand(0)->getType()->getIntegerBitWidth())
+        return X;
+      break;
+    }
+
+    return nullptr;
+  }
+
+  static bool foldDemandedBits(Instruction &I) 
+  {
+    if (!I.getType()->isIntegerTy()) return false;
+
+    unsigned Width = I.getType()->getIntegerBitWidth();
+    Value *X = nullptr; const APInt *C = nullptr;
+
+    if (match(&I, m_And(m_Value(X), m_APInt(C)))) 
+    {
+      KnownBits Known = getKnownBits(X, I);
+      if (C->isSubsetOf(Known.Zero))
+        return replaceInst(I, Constant::getNullValue(I.getType()));
+      // Mask only clears bits that are already zero
+      if ((~*C).isSubsetOf(Known.Zero))
+        return replaceInst(I, X);
+    }
+
+    if (match(&I, m_Or(m_Value(X), m_APInt(C)))) 
+    {
+      if (C->isSubsetOf(getKnownBits(X, I).One))
+        return replaceInst(I, X);
+    }
+
+    // Narrow the first operand to the bits that actually reach the result
+    APInt Demanded;
+    if (match(&I, m_And(m_Value(X), m_APInt(C))))
+      Demanded = *C;
+    else if (match(&I, m_Or(m_Value(X), m_APInt(C))))
+      Demanded = ~*C;
+    else if (match(&I, m_Shl(m_Value(X), m_APInt(C))) && C->ult(Width))
+      Demanded = APInt::getLowBitsSet(Width, Width - C->getZExtValue());
+    else if (match(&I, m_LShr(m_Value(X), m_APInt(C))) && C->ult(Width))
+      Demanded = APInt::getHighBitsSet(Width, Width - C->getZExtValue());
+    else if (match(&I, m_Trunc(m_Value(X))) && X->getType()->isIntegerTy())
+      Demanded = APInt::getLowBitsSet(X->getType()->getIntegerBitWidth(), Width);
+    else
+      return false;
+
+    Value *Simpler = simplifyDemandedBits(X, Demanded, I);
+    if (!Simpler || Simpler == X) return false;
+
+    // nuw, exact, disjoint and the like held for X, not for the bits it no longer clears
+    I.dropPoisonGeneratingFlags();
+    I.setOperand(0, Simpler);
+    return true;
+  }
+
+  static bool foldCastChain(Instruction &I) 
+  {
+    auto *Outer = dyn_cast<CastInst>(&I);
+    if (!Outer) return false;
+    auto *Inner = dyn_cast<CastInst>(Outer->getOperand(0));
+    if (!Inner) return false;
+
+    Value *X = Inner->getOperand(0);
+    Type *SrcTy = X->getType(), *DstTy = I.getType();
+    unsigned OuterOp = Outer->getOpcode(), InnerOp = Inner->getOpcode();
+    IRBuilder<> B(&I);
+
+    if (OuterOp == Instruction::BitCast && InnerOp == Instruction::BitCast) 
+    {
+      if (SrcTy == DstTy) return replaceInst(I, X);
+      return replaceInst(I, B.CreateBitCast(X, DstTy, "cast.fold"));
+    }
+
+    if (!SrcTy->isIntegerTy() || !DstTy->isIntegerTy()) return false;
+
+    unsigned SrcW = SrcTy->getIntegerBitWidth();
+    unsigned DstW = DstTy->getIntegerBitWidth();
+    bool InnerExt = InnerOp == Instruction::ZExt || InnerOp == Instruction::SExt;
+
+    // zext (zext X), sext (sext X) and sext (zext X) are a single extension of X
+    if (InnerExt && (OuterOp == Instruction::ZExt || OuterOp == Instruction::SExt)) 
+    {
+      if (InnerOp == Instruction::ZExt)
+        return replaceInst(I, B.CreateZExt(X, DstTy, "cast.fold"));
+      if (OuterOp == Instruction::SExt)
+        return replaceInst(I, B.CreateSExt(X, DstTy, "cast.fold"));
+      return false;
+    }
+
+    // trunc (ext X) keeps X, part of it, or part of its extension
+    if (InnerExt && OuterOp == Instruction::Trunc) 
+    {
+      if (SrcW == DstW) return replaceInst(I, X);
+      if (SrcW > DstW) return replaceInst(I, B.CreateTrunc(X, DstTy, "cast.fold"));
+      if (InnerOp == Instruction::ZExt)
+        return replaceInst(I, B.CreateZExt(X, DstTy, "cast.fold"));
+      return replaceInst(I, B.CreateSExt(X, DstTy, "cast.fold"));
+    }
+
+    if (InnerOp == Instruction::Trunc && OuterOp == Instruction::Trunc)
+      return replaceInst(I, B.CreateTrunc(X, DstTy, "cast.fold"));
+
+    // zext (trunc X) back to the type of X only clears the truncated bits
+    if (InnerOp == Instruction::Trunc && OuterOp == Instruction::ZExt && SrcW == DstW) 
+    {
+      unsigned MidW = Inner->getType()->getIntegerBitWidth();
+      Value *Mask = ConstantInt::get(DstTy, APInt::getLowBitsSet(DstW, MidW));
+      return replaceInst(I, B.CreateAnd(X, Mask, "cast.mask"));
+    }
+
+    return false;
+  }
+
+  static bool foldGEPChain(Instruction &I) 
+  {
+    auto *GEP = dyn_cast<GetElementPtrInst>(&I);
+    if (!GEP) return false;
+    auto *Inner = dyn_cast<GetElementPtrInst>(GEP->getPointerOperand());
+    if (!Inner || GEP->getType()->isVectorTy() || Inner->getType()->isVectorTy()) return false;
+
+    const DataLayout &DL = I.getModule()->getDataLayout();
+    unsigned IdxWidth = DL.getIndexTypeSizeInBits(GEP->getType());
+    APInt Offset(IdxWidth, 0), InnerOffset(IdxWidth, 0);
+    if (!GEP->accumulateConstantOffset(DL, Offset) || !Inner->accumulateConstantOffset(DL, InnerOffset))
+      return false;
+
+    Value *Base = Inner->getPointerOperand();
+    APInt Total = InnerOffset + Offset;
+    if (Total.isZero() && Base->getType() == I.getType())
+      return replaceInst(I, Base);
+
+    // Both steps are constant, so one byte offset from the inner base is enough
+    IRBuilder<> B(&I);
+    Value *Idx = ConstantInt::get(DL.getIndexType(GEP->getType()), Total);
+    if (GEP->isInBounds() && Inner->isInBounds())
+      return replaceInst(I, B.CreateInBoundsGEP(B.getInt8Ty(), Base, Idx, "gep.fold"));
+    return replaceInst(I, B.CreateGEP(B.getInt8Ty(), Base, Idx, "gep.fold"));
+  }
+
+  static bool foldRotate(Instruction &I) 
+  {
+    if (!I.getType()->isIntegerTy()) return false;
+
+    Value *X = nullptr, *ShlAmt = nullptr, *ShrAmt = nullptr;
+    if (!match(&I, m_c_Or(m_Shl(m_Value(X), m_Value(ShlAmt)), m_LShr(m_Deferred(X), m_Value(ShrAmt)))))
+      return false;
+
+    unsigned Width = I.getType()->getIntegerBitWidth();
+    IRBuilder<> B(&I);
+    const APInt *C1 = nullptr, *C2 = nullptr;
+    Value *S = nullptr;
+
+    // (X << C) | (X >> (W - C))
+    if (match(ShlAmt, m_APInt(C1)) && match(ShrAmt, m_APInt(C2)) && 
+        C1->ult(Width) && C2->ult(Width) && (*C1 + *C2) == Width)
+      return replaceInst(I, B.CreateIntrinsic(Intrinsic::fshl, {I.getType()}, {X, X, ShlAmt}, nullptr, "rotl"));
+
+    // (X << S) | (X >> (W - S))
+    if (match(ShrAmt, m_Sub(m_SpecificInt(Width), m_Specific(ShlAmt))))
+      return replaceInst(I, B.CreateIntrinsic(Intrinsic::fshl, {I.getType()}, {X, X, ShlAmt}, nullptr, "rotl"));
+
+    // (X << (W - S)) | (X >> S)
+    if (match(ShlAmt, m_Sub(m_SpecificInt(Width), m_Value(S))) && S == ShrAmt)
+      return replaceInst(I, B.CreateIntrinsic(Intrinsic::fshr, {I.getType()}, {X, X, ShrAmt}, nullptr, "rotr"));
+
+    return false;
+  }
+
+  // Describes V as (Src shifted left by Shift) & Mask, negative Shift meaning lshr
+  static bool matchShiftedMask(Value *V, Value *&Src, int &Shift, APInt &Mask, unsigned Depth = 0) 
+  {
+    unsigned Width = Mask.getBitWidth();
+    const APInt *C = nullptr;
+    Value *Op = nullptr;
+
+    if (Depth < 4 && match(V, m_And(m_Value(Op), m_APInt(C)))) 
+    {
+      if (!matchShiftedMask(Op, Src, Shift, Mask, Depth + 1)) return false;
+      Mask &= *C;
+      return true;
+    }
+
+    if (Depth < 4 && match(V, m_Shl(m_Value(Op), m_APInt(C))) && C->ult(Width)) 
+    {
+      if (!matchShiftedMask(Op, Src, Shift, Mask, Depth + 1)) return false;
+      Shift += C->getZExtValue();
+      Mask = Mask.shl(C->getZExtValue());
+      return true;
+    }
+
+    if (Depth < 4 && match(V, m_LShr(m_Value(Op), m_APInt(C))) && C->ult(Width)) 
+    {
+      if (!matchShiftedMask(Op, Src, Shift, Mask, Depth + 1)) return false;
+      Shift -= C->getZExtValue();
+      Mask = Mask.lshr(C->getZExtValue());
+      return true;
+    }
+
+    Src = V;
+    Shift = 0;
+    Mask = APInt::getAllOnes(Width);
+    return true;
+  }
+
+  static bool foldBSwap(Instruction &I) 
+  {
+    if (I.getOpcode() != Instruction::Or || !I.getType()->isIntegerTy()) return false;
+
+    unsigned Width = I.getType()->getIntegerBitWidth();
+    if (Width < 16 || Width % 16 != 0) return false;
+    unsigned Bytes = Width / 8;
+
+    // Flatten the or tree into the byte moves it is made of
+    SmallVector<Value*, 8> Leaves;
+    SmallVector<Value*, 8> Stack = {&I};
+    while (!Stack.empty()) 
+    {
+      Value *V = Stack.pop_back_val();
+      Value *L = nullptr, *R = nullptr;
+      if (match(V, m_Or(m_Value(L), m_Value(R))) && Leaves.size() + Stack.size() < 2 * Bytes) 
+      {
+        Stack.push_back(L);
+        Stack.push_back(R);
+      }
+      else
+        Leaves.push_back(V);
+    }
+
+    Value *Src = nullptr;
+    APInt Covered = APInt::getZero(Width);
+    for (Value *Leaf : Leaves) 
+    {
+      Value *LeafSrc = nullptr;
+      int Shift = 0;
+      APInt Mask(Width, 0);
+      if (!matchShiftedMask(Leaf, LeafSrc, Shift, Mask)) return false;
+      if (Src && LeafSrc != Src) return false;
+      Src = LeafSrc;
+      if (Shift % 8 != 0 || Mask.intersects(Covered)) return false;
+
+      // Every byte the leaf produces must be the mirrored byte of Src
+      for (unsigned J = 0; J < Bytes; ++J) 
+      {
+        APInt Byte = Mask.extractBits(8, J * 8);
+        if (Byte.isZero()) continue;
+        if (!Byte.isAllOnes()) return false;
+        if ((int)J - Shift / 8 != (int)(Bytes - 1 - J)) return false;
+      }
+      Covered |= Mask;
+    }
+
+    if (!Covered.isAllOnes() || Src->getType() != I.getType()) return false;
+
+    IRBuilder<> B(&I);
+    return replaceInst(I, B.CreateUnaryIntrinsic(Intrinsic::bswap, Src, nullptr, "bswap"));
+  }
+
+  static bool foldMinMax(Instruction &I) 
+  {
+    auto *Sel = dyn_cast<SelectInst>(&I);
+    if (!Sel || !I.getType()->isIntegerTy()) return false;
+
+    ICmpInst::Predicate Pred;
+    Value *A = nullptr, *B = nullptr;
+    if (!match(Sel->getCondition(), m_ICmp(Pred, m_Value(A), m_Value(B)))) return false;
+
+    // select (A < B), B, A picks the other end
+    if (Sel->getTrueValue() == B && Sel->getFalseValue() == A)
+      Pred = ICmpInst::getInversePredicate(Pred);
+    else if (Sel->getTrueValue() != A || Sel->getFalseValue() != B)
+      return false;
+
+    Intrinsic::ID ID;
+    switch (Pred) 
+    {
+    case ICmpInst::ICMP_SLT: case ICmpInst::ICMP_SLE: ID = Intrinsic::smin; break;
+    case ICmpInst::ICMP_SGT: case ICmpInst::ICMP_SGE: ID = Intrinsic::smax; break;
+    case ICmpInst::ICMP_ULT: case ICmpInst::ICMP_ULE: ID = Intrinsic::umin; break;
+    case ICmpInst::ICMP_UGT: case ICmpInst::ICMP_UGE: ID = Intrinsic::umax; break;
+    default: return false;
+    }
+
+    IRBuilder<> Builder(&I);
+    return replaceInst(I, Builder.CreateBinaryIntrinsic(ID, A, B, nullptr, "minmax"));
+  }
+
+  static bool foldAbs(Instruction &I) 
+  {
+    auto *Sel = dyn_cast<SelectInst>(&I);
+    if (!Sel || !I.getType()->isIntegerTy()) return false;
+
+    ICmpInst::Predicate Pred;
+    Value *X = nullptr;
+    const APInt *C = nullptr;
+    if (!match(Sel->getCondition(), m_ICmp(Pred, m_Value(X), m_APInt(C)))) return false;
+
+    // Condition true means X < 0 (or X <= 0, where -X == X anyway)
+    bool TrueIfNeg;
+    if ((Pred == ICmpInst::ICMP_SLT || Pred == ICmpInst::ICMP_SLE) && C->isZero())
+      TrueIfNeg = true;
+    else if ((Pred == ICmpInst::ICMP_SGT && (C->isAllOnes() || C->isZero())) ||
+             (Pred == ICmpInst::ICMP_SGE && C->isZero()))
+      TrueIfNeg = false;
+    else
+      return false;
+
+    Value *Neg = TrueIfNeg ? Sel->getTrueValue() : Sel->getFalseValue();
+    Value *Pos = TrueIfNeg ? Sel->getFalseValue() : Sel->getTrueValue();
+    if (Pos != X || !match(Neg, m_Neg(m_Specific(X)))) return false;
+
+    // A nsw negation already makes INT_MIN poison
+    auto *NegBO = dyn_cast<BinaryOperator>(Neg);
+    bool IntMinIsPoison = NegBO && NegBO->hasNoSignedWrap();
+    IRBuilder<> B(&I);
+    return replaceInst(I, B.CreateBinaryIntrinsic(Intrinsic::abs, X, B.getInt1(IntMinIsPoison), nullptr, "abs"));
+  }
+
+  static bool removeDeadInstructions(Function &F) 
+  {
+    bool Changed = false;
+    for (BasicBlock &BB : F) 
+    {
+      // Walk backwards so whole dead chains go in one sweep
+      for (auto It = BB.rbegin(); It != BB.rend(); ) 
+      {
+        Instruction &I = *It++;
+        if (isInstructionTriviallyDead(&I)) 
+        {
+          I.eraseFromParent();
+          Changed = true;
+        }
+      }
+    }
+    return Changed;
+  }
+
   static bool foldConstOp(Instruction &I) 
   {
     auto *BO = dyn_cast<BinaryOperator>(&I);
@@ -365,7 +810,381 @@ struct MyInstCombine : public FunctionPass {
     return false;
   }
 
-  static bool applyOptimizations(Instruction &I) 
+  // Range of values V can take, from its known bits and a few value-limiting ops
+  static ConstantRange getValueRange(Value *V, bool IsSigned, const Instruction &CxtI) 
+  {
+    ConstantRange CR = ConstantRange::fromKnownBits(getKnownBits(V, CxtI), IsSigned);
+
+    const APInt *C = nullptr;
+    if (match(V, m_URem(m_Value(), m_APInt(C))) && !C->isZero())
+      CR = CR.intersectWith(ConstantRange(APInt::getZero(C->getBitWidth()), *C));
+
+    return CR;
+  }
+
+  // Folds Cmp to a constant when X is known to lie in Range
+  static bool foldICmpInRange(ICmpInst &Cmp, const ConstantRange &Range) 
+  {
+    auto *C = dyn_cast<ConstantInt>(Cmp.getOperand(1));
+    if (!C) return false;
+
+    ConstantRange RHS(C->getValue());
+    if (ConstantRange::makeSatisfyingICmpRegion(Cmp.getPredicate(), RHS).contains(Range))
+      return replaceInst(Cmp, ConstantInt::getTrue(Cmp.getType()));
+
+    if (ConstantRange::makeAllowedICmpRegion(Cmp.getPredicate(), RHS).intersectWith(Range).isEmptySet())
+      return replaceInst(Cmp, ConstantInt::getFalse(Cmp.getType()));
+
+    return false;
+  }
+
+  static bool foldICmpWithRange(Instruction &I) 
+  {
+    auto *Cmp = dyn_cast<ICmpInst>(&I);
+    if (!Cmp || !isa<ConstantInt>(Cmp->getOperand(1))) return false;
+
+    Value *X = Cmp->getOperand(0);
+    return foldICmpInRange(*Cmp, getValueRange(X, Cmp->isSigned(), I));
+  }
+
+  // (X P1 C1) and/or (X P2 C2) is a single range check on X
+  static bool foldICmpPairWithRange(Instruction &I) 
+  {
+    auto *BO = dyn_cast<BinaryOperator>(&I);
+    if (!BO || !I.getType()->isIntegerTy(1)) return false;
+
+    bool IsAnd = BO->getOpcode() == Instruction::And;
+    if (!IsAnd && BO->getOpcode() != Instruction::Or) return false;
+
+    ICmpInst::Predicate P1, P2;
+    Value *X = nullptr;
+    const APInt *C1 = nullptr, *C2 = nullptr;
+    if (!match(BO, m_c_BinOp(m_ICmp(P1, m_Value(X), m_APInt(C1)), m_ICmp(P2, m_Deferred(X), m_APInt(C2)))))
+      return false;
+
+    ConstantRange R1 = ConstantRange::makeExactICmpRegion(P1, *C1);
+    ConstantRange R2 = ConstantRange::makeExactICmpRegion(P2, *C2);
+    auto R = IsAnd ? R1.exactIntersectWith(R2) : R1.exactUnionWith(R2);
+    if (!R) return false;
+
+    if (R->isEmptySet())
+      return replaceInst(I, ConstantInt::getFalse(I.getType()));
+    if (R->isFullSet())
+      return replaceInst(I, ConstantInt::getTrue(I.getType()));
+
+    CmpInst::Predicate Pred;
+    APInt RHS;
+    if (!R->getEquivalentICmp(Pred, RHS)) return false;
+
+    IRBuilder<> B(&I);
+    return replaceInst(I, B.CreateICmp(Pred, X, ConstantInt::get(X->getType(), RHS), "range"));
+  }
+
+  // Folds an icmp already decided by the branches that lead to it
+  bool foldICmpByDominatingCondition(Instruction &I) 
+  {
+    auto *Cmp = dyn_cast<ICmpInst>(&I);
+    if (!Cmp || !DT || !DT->isReachableFromEntry(I.getParent())) return false;
+
+    Value *X = Cmp->getOperand(0), *Y = Cmp->getOperand(1);
+    bool HasConstRHS = isa<ConstantInt>(Y);
+    ConstantRange Range = ConstantRange::getFull(HasConstRHS ? X->getType()->getIntegerBitWidth() : 1);
+    const unsigned MaxDepth = 8;
+
+    DomTreeNode *Node = DT->getNode(I.getParent());
+    for (unsigned Depth = 0; Depth < MaxDepth && Node->getIDom(); ++Depth) 
+    {
+      Node = Node->getIDom();
+      BasicBlock *Dom = Node->getBlock();
+
+      auto *Br = dyn_cast<BranchInst>(Dom->getTerminator());
+      if (!Br || !Br->isConditional() || Br->getSuccessor(0) == Br->getSuccessor(1)) continue;
+
+      bool OnTrueEdge;
+      if (DT->dominates(BasicBlockEdge(Dom, Br->getSuccessor(0)), I.getParent()))
+        OnTrueEdge = true;
+      else if (DT->dominates(BasicBlockEdge(Dom, Br->getSuccessor(1)), I.getParent()))
+        OnTrueEdge = false;
+      else
+        continue;
+
+      ICmpInst::Predicate DomPred;
+      Value *A = nullptr, *B = nullptr;
+      if (!match(Br->getCondition(), m_ICmp(DomPred, m_Value(A), m_Value(B)))) continue;
+      if (!OnTrueEdge) DomPred = ICmpInst::getInversePredicate(DomPred);
+
+      // Same operands: the dominating predicate decides this one directly
+      if (A == Y && B == X) 
+      {
+        std::swap(A, B);
+        DomPred = ICmpInst::getSwappedPredicate(DomPred);
+      }
+      if (A == X && B == Y) 
+      {
+        if (DomPred == Cmp->getPredicate())
+          return replaceInst(I, ConstantInt::getTrue(I.getType()));
+        if (DomPred == Cmp->getInversePredicate())
+          return replaceInst(I, ConstantInt::getFalse(I.getType()));
+      }
+
+      // Constant bounds on X accumulate along the path
+      auto *DomC = dyn_cast<ConstantInt>(B);
+      if (A == X && DomC && HasConstRHS) 
+      {
+        Range = Range.intersectWith(ConstantRange::makeExactICmpRegion(DomPred, DomC->getValue()));
+        if (foldICmpInRange(*Cmp, Range))
+          return true;
+      }
+    }
+
+    return false;
+  }
+
+  static bool foldSelectBasics(Instruction &I) 
+  {
+    auto *Sel = dyn_cast<SelectInst>(&I);
+    if (!Sel) return false;
+
+    Value *C = Sel->getCondition();
+    Value *T = Sel->getTrueValue(), *F = Sel->getFalseValue();
+
+    if (T == F)
+      return replaceInst(I, T);
+
+    if (auto *CC = dyn_cast<ConstantInt>(C))
+      return replaceInst(I, CC->isOne() ? T : F);
+
+    // Selects between constants of the same shape as the condition are casts of it
+    if (C->getType() != I.getType() && !(I.getType()->isIntegerTy() && C->getType()->isIntegerTy(1)))
+      return false;
+
+    // C may be a vector of i1, so its negation xors with all ones of its type
+    IRBuilder<> B(&I);
+    if (I.getType()->isIntOrIntVectorTy(1)) 
+    {
+      if (match(T, m_One()) && match(F, m_Zero()))
+        return replaceInst(I, C);
+      if (match(T, m_Zero()) && match(F, m_One()))
+        return replaceInst(I, B.CreateXor(C, Constant::getAllOnesValue(C->getType()), "not"));
+      return false;
+    }
+
+    if (match(T, m_One()) && match(F, m_Zero()))
+      return replaceInst(I, B.CreateZExt(C, I.getType(), "sel.zext"));
+    if (match(T, m_AllOnes()) && match(F, m_Zero()))
+      return replaceInst(I, B.CreateSExt(C, I.getType(), "sel.sext"));
+
+    if (match(T, m_Zero()) && (match(F, m_One()) || match(F, m_AllOnes()))) 
+    {
+      Value *NotC = B.CreateXor(C, Constant::getAllOnesValue(C->getType()), "not");
+      if (match(F, m_One()))
+        return replaceInst(I, B.CreateZExt(NotC, I.getType(), "sel.zext"));
+      return replaceInst(I, B.CreateSExt(NotC, I.getType(), "sel.sext"));
+    }
+
+    return false;
+  }
+
+  // (select C, K1, K2) op K becomes select C, (K1 op K), (K2 op K)
+  static bool foldBinOpIntoSelect(Instruction &I) 
+  {
+    auto *BO = dyn_cast<BinaryOperator>(&I);
+    if (!BO) return false;
+
+    for (unsigned Idx = 0; Idx < 2; ++Idx) 
+    {
+      auto *Sel = dyn_cast<SelectInst>(BO->getOperand(Idx));
+      auto *K = dyn_cast<Constant>(BO->getOperand(1 - Idx));
+      if (!Sel || !K || !Sel->hasOneUse()) continue;
+
+      auto *T = dyn_cast<Constant>(Sel->getTrueValue());
+      auto *F = dyn_cast<Constant>(Sel->getFalseValue());
+      if (!T || !F) continue;
+
+      const DataLayout &DL = I.getModule()->getDataLayout();
+      Constant *NewT = Idx == 0 ? ConstantFoldBinaryOpOperands(BO->getOpcode(), T, K, DL)
+                                : ConstantFoldBinaryOpOperands(BO->getOpcode(), K, T, DL);
+      Constant *NewF = Idx == 0 ? ConstantFoldBinaryOpOperands(BO->getOpcode(), F, K, DL)
+                                : ConstantFoldBinaryOpOperands(BO->getOpcode(), K, F, DL);
+      if (!NewT || !NewF) continue;
+
+      IRBuilder<> B(&I);
+      return replaceInst(I, B.CreateSelect(Sel->getCondition(), NewT, NewF, "sel.fold"));
+    }
+
+    return false;
+  }
+
+  // A phi whose incoming values are all V is V, as long as V is available here
+  bool foldPhiSameIncoming(Instruction &I) 
+  {
+    auto *PN = dyn_cast<PHINode>(&I);
+    if (!PN) return false;
+
+    Value *Common = nullptr;
+    for (Value *In : PN->incoming_values()) 
+    {
+      if (In == PN) continue;
+      if (Common && In != Common) return false;
+      Common = In;
+    }
+    if (!Common) return false;
+
+    if (auto *CI = dyn_cast<Instruction>(Common))
+      if (!DT || !DT->dominates(CI, PN)) return false;
+
+    return replaceInst(I, Common);
+  }
+
+  // phi [a op X], [b op X] becomes (phi [a], [b]) op X
+  bool foldPhiOfBinOps(Instruction &I) 
+  {
+    auto *PN = dyn_cast<PHINode>(&I);
+    if (!PN || PN->getNumIncomingValues() < 2) return false;
+
+    auto *First = dyn_cast<BinaryOperator>(PN->getIncomingValue(0));
+    if (!First) return false;
+
+    // Find which side is shared by every incoming operation
+    bool SharedRHS = true, SharedLHS = true;
+    for (Value *In : PN->incoming_values()) 
+    {
+      auto *BO = dyn_cast<BinaryOperator>(In);
+      if (!BO || BO->getOpcode() != First->getOpcode() || !BO->hasOneUser()) return false;
+      SharedLHS &= BO->getOperand(0) == First->getOperand(0);
+      SharedRHS &= BO->getOperand(1) == First->getOperand(1);
+    }
+    if (!SharedLHS && !SharedRHS) return false;
+
+    unsigned SharedIdx = SharedRHS ? 1 : 0;
+    Value *Shared = First->getOperand(SharedIdx);
+    if (auto *SI = dyn_cast<Instruction>(Shared))
+      if (!DT || !DT->dominates(SI, PN)) return false;
+
+    IRBuilder<> B(PN);
+    PHINode *NewPN = B.CreatePHI(Shared->getType(), PN->getNumIncomingValues(), PN->getName() + ".op");
+    for (unsigned Idx = 0; Idx < PN->getNumIncomingValues(); ++Idx) 
+    {
+      auto *BO = cast<BinaryOperator>(PN->getIncomingValue(Idx));
+      NewPN->addIncoming(BO->getOperand(1 - SharedIdx), PN->getIncomingBlock(Idx));
+    }
+
+    B.SetInsertPoint(PN->getParent(), PN->getParent()->getFirstInsertionPt());
+    Value *LHS = SharedIdx == 1 ? (Value *)NewPN : Shared;
+    Value *RHS = SharedIdx == 1 ? Shared : (Value *)NewPN;
+    auto *NewBO = cast<BinaryOperator>(B.CreateBinOp(First->getOpcode(), LHS, RHS, "phi.fold"));
+
+    // Keep only the wrap/exact flags every incoming operation had
+    NewBO->copyIRFlags(First);
+    for (Value *In : PN->incoming_values())
+      NewBO->andIRFlags(In);
+
+    return replaceInst(I, NewBO);
+  }
+
+  // Reuses the value of an earlier store or load to the same location in the block
+  bool forwardToLoad(Instruction &I) 
+  {
+    auto *LI = dyn_cast<LoadInst>(&I);
+    if (!LI || !LI->isSimple() || !AA) return false;
+
+    MemoryLocation Loc = MemoryLocation::get(LI);
+    unsigned Scanned = 0;
+    for (auto It = LI->getReverseIterator(); ++It != LI->getParent()->rend() && Scanned < MaxMemScan; ++Scanned) 
+    {
+      Instruction *Prev = &*It;
+
+      if (auto *SI = dyn_cast<StoreInst>(Prev)) 
+      {
+        if (SI->isSimple() && SI->getValueOperand()->getType() == LI->getType() &&
+            AA->alias(MemoryLocation::get(SI), Loc) == AliasResult::MustAlias)
+          return replaceInst(I, SI->getValueOperand());
+      }
+
+      if (auto *PrevLI = dyn_cast<LoadInst>(Prev)) 
+      {
+        if (PrevLI->isSimple() && PrevLI->getType() == LI->getType() &&
+            AA->alias(MemoryLocation::get(PrevLI), Loc) == AliasResult::MustAlias)
+          return replaceInst(I, PrevLI);
+      }
+
+      if (isModSet(AA->getModRefInfo(Prev, Loc))) return false;
+    }
+
+    return false;
+  }
+
+  // Deletes a store that is overwritten in the same block before anything reads it
+  bool removeOverwrittenStore(Instruction &I) 
+  {
+    auto *SI = dyn_cast<StoreInst>(&I);
+    if (!SI || !SI->isSimple() || !AA) return false;
+
+    MemoryLocation Loc = MemoryLocation::get(SI);
+    const DataLayout &DL = I.getModule()->getDataLayout();
+    unsigned Scanned = 0;
+    for (Instruction *Next = SI->getNextNode(); Next && Scanned < MaxMemScan; Next = Next->getNextNode(), ++Scanned) 
+    {
+      if (auto *Later = dyn_cast<StoreInst>(Next)) 
+      {
+        if (Later->isSimple() && AA->alias(MemoryLocation::get(Later), Loc) == AliasResult::MustAlias &&
+            DL.getTypeStoreSize(Later->getValueOperand()->getType()) >= 
+            DL.getTypeStoreSize(SI->getValueOperand()->getType())) 
+        {
+          I.eraseFromParent();
+          return true;
+        }
+      }
+
+      // The stored value is observable if anything reads it or we unwind out of here
+      if (Next->mayThrow() || isRefSet(AA->getModRefInfo(Next, Loc))) return false;
+    }
+
+    return false;
+  }
+
+  // Replaces small constant-size memcpy/memmove/memset with one wide access
+  static bool expandSmallMemIntrinsic(Instruction &I) 
+  {
+    auto *MI = dyn_cast<MemIntrinsic>(&I);
+    if (!MI || MI->isVolatile()) return false;
+
+    auto *Len = dyn_cast<ConstantInt>(MI->getLength());
+    if (!Len) return false;
+    uint64_t Bytes = Len->getZExtValue();
+    if (Bytes == 0 || Bytes > 16 || !isPowerOf2_64(Bytes)) return false;
+
+    IRBuilder<> B(&I);
+    Type *Ty = B.getIntNTy(Bytes * 8);
+    // The accesses keep the intrinsic's TBAA and scopes, a tbaa.struct
+    // describing one field of exactly this size becomes their TBAA tag
+    AAMDNodes AATags = MI->getAAMetadata().adjustForAccess(Bytes);
+
+    if (auto *MT = dyn_cast<MemTransferInst>(MI)) 
+    {
+      // The whole value is loaded before storing, so overlapping memmove is fine too
+      LoadInst *Val = B.CreateAlignedLoad(Ty, MT->getRawSource(), MT->getSourceAlign().valueOrOne(), "memcpy.val");
+      Val->setAAMetadata(AATags);
+      B.CreateAlignedStore(Val, MT->getRawDest(), MT->getDestAlign().valueOrOne())->setAAMetadata(AATags);
+    }
+    else if (auto *MS = dyn_cast<MemSetInst>(MI)) 
+    {
+      Value *Byte = MS->getValue();
+      Value *Val = nullptr;
+      if (auto *CB = dyn_cast<ConstantInt>(Byte))
+        Val = ConstantInt::get(Ty, APInt::getSplat(Bytes * 8, CB->getValue()));
+      else
+        Val = B.CreateMul(B.CreateZExt(Byte, Ty, "memset.byte"), ConstantInt::get(Ty, APInt::getSplat(Bytes * 8, APInt(8, 1))), "memset.val");
+      B.CreateAlignedStore(Val, MS->getRawDest(), MS->getDestAlign().valueOrOne())->setAAMetadata(AATags);
+    }
+    else
+      return false;
+
+    I.eraseFromParent();
+    return true;
+  }
+
+  bool applyOptimizations(Instruction &I) 
   {
 
     auto Opts = {
@@ -373,9 +1192,22 @@ struct MyInstCombine : public FunctionPass {
         orderBitwiseWithConst,
         foldRelICmpToEqNe,
         foldICmpOnBool,
+        foldICmpWithRange,
+        foldICmpPairWithRange,
         foldAddXX,
         foldMulPow2ToShl,
         foldDivPow2ToShr,
+        foldRemPow2ToAnd,
+        foldDemandedBits,
+        foldCastChain,
+        foldGEPChain,
+        foldBSwap,
+        foldRotate,
+        foldMinMax,
+        foldAbs,
+        foldSelectBasics,
+        foldBinOpIntoSelect,
+        expandSmallMemIntrinsic,
         foldSimpleArith,
         foldLogicBasics,
         foldConstOp,
@@ -384,23 +1216,53 @@ struct MyInstCombine : public FunctionPass {
         foldFAddZero              
     };
 
+    bool Degraded = Budget.isDegraded();
     for(auto &Opt : Opts)
     {
+      // These walk operand trees for known bits, the first thing to blow up on large functions
+      if (Degraded && (Opt == foldDemandedBits || Opt == foldICmpWithRange || Opt == foldICmpPairWithRange))
+        continue;
       if (Opt(I))
         return true;
     }
 
+    if (Degraded) return false;
+    return forwardToLoad(I) ||
+           removeOverwrittenStore(I) ||
+           foldPhiSameIncoming(I) ||
+           foldPhiOfBinOps(I) ||
+           foldICmpByDominatingCondition(I);
+  }
+
+  bool doInitialization(Module &M) override
+  {
+    Budget = mypassutils::CompileBudget("my-inst-combine", {WorkBudget, TimeBudget},
+                                        {ModuleWorkBudget, ModuleTimeBudget});
+    Budget.startModule();
     return false;
   }
 
   bool runOnFunction(Function &F) override
   {
+    Budget.startFunction(F);
+    if (Budget.isExhausted())
+    {
+      Budget.finishFunction();
+      return false;
+    }
+    DT = Budget.isDegraded() ? nullptr : &getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+    AA = Budget.isDegraded() ? nullptr : &getAnalysis<AAResultsWrapperPass>().getAAResults();
+
+    mypassutils::CostSummary Before;
+    if (!CostReportFile.empty())
+      Before = computeCost(F);
+    unsigned Folds = 0;
+
     bool Changed = false;
     bool LocalChanged = true;
     unsigned IterationCount = 0;
-    const unsigned MaxIterations = 100; 
 
-    while (LocalChanged && IterationCount < MaxIterations) 
+    while (LocalChanged && IterationCount < MaxIterations && !Budget.isExhausted()) 
     {
       LocalChanged = false;
       IterationCount++;
@@ -420,6 +1282,14 @@ struct MyInstCombine : public FunctionPass {
         
         if (!I || !I->getParent()) continue;
 
+        // Every fold leaves valid IR behind, so stopping in the middle is safe
+        if (Budget.charge() == mypassutils::CompileBudget::Exhausted) break;
+        if (Budget.isDegraded())
+        {
+          DT = nullptr;
+          AA = nullptr;
+        }
+
         // Store users before optimization (they might be needed for worklist)
         SmallVector<Instruction*> Users;
         for (User *U : I->users()) 
@@ -432,6 +1302,7 @@ struct MyInstCombine : public FunctionPass {
 
         bool InstChanged = applyOptimizations(*I);
         LocalChanged |= InstChanged;
+        Folds += InstChanged;
         
         // If we modified this instruction, add its users back to the worklist
         // This ensures we catch new optimization opportunities that emerge
@@ -450,12 +1321,52 @@ struct MyInstCombine : public FunctionPass {
           }
         }
       }
+
+      // Folds above leave their old operand trees behind
+      LocalChanged |= removeDeadInstructions(F);
       
       Changed |= LocalChanged;
     }
+    Budget.finishFunction();
+
+    if (LocalChanged && IterationCount == MaxIterations)
+    {
+      OptimizationRemarkEmitter ORE(&F);
+      ORE.emit([&] {
+        return OptimizationRemarkMissed("my-inst-combine", "MaxIterations",
+                                        DiagnosticLocation(F.getSubprogram()), &F.getEntryBlock())
+               << ore::NV("Function", &F) << ": stopped after " << ore::NV("Iterations", IterationCount)
+               << " iterations without reaching a fixpoint";
+      });
+    }
+
+    if (!CostReportFile.empty())
+    {
+      mypassutils::CostSummary After = computeCost(F);
+      mypassutils::appendCostRecord(CostReportFile, "my-inst-combine", *F.getParent(), F.getName(),
+                                    Before, &After, {{"folds", Folds}});
+    }
     
     return Changed;
   }
+
+  mypassutils::CostSummary computeCost(Function &F)
+  {
+    return mypassutils::computeCost(F, getAnalysis<TargetTransformInfoWrapperPass>().getTTI(F),
+                                    getAnalysis<TargetLibraryInfoWrapperPass>().getTLI(F));
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override 
+  {
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.addRequired<AAResultsWrapperPass>();
+    if (!CostReportFile.empty())
+    {
+      AU.addRequired<TargetLibraryInfoWrapperPass>();
+      AU.addRequired<TargetTransformInfoWrapperPass>();
+    }
+    AU.setPreservesCFG();
+  }
 };
 
 } // namespace
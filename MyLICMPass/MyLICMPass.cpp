@@ -8,6 +8,7 @@
 #include "llvm/IR/CFG.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instruction.h"
+#include "llvm/IR/PatternMatch.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
@@ -19,12 +20,18 @@
 #include <algorithm>
 #include <iterator>
 #include <llvm/Analysis/BranchProbabilityInfo.h>
+#include <optional>
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/Analysis/MemoryLocation.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Analysis/VectorUtils.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Transforms/Utils/PromoteMemToReg.h"
 
 #include <llvm/Passes/PassBuilder.h>
 #include <llvm/Passes/PassPlugin.h>
@@ -33,8 +40,44 @@
 #define OPTLOADSTORE true
 #define CONSERVATIVE false
 
+#include "CompileBudget.h"
+#include "CostReport.h"
+#include "PassLog.h"
+
 using namespace llvm;
 
+static cl::opt<std::string> CostReportFile(
+    "my-licm-cost-report", cl::value_desc("filename"),
+    cl::desc("Append the TTI cost of every function with loops before and after my-licm to this file as JSON lines"));
+
+static cl::opt<bool> ParallelMetadata(
+    "my-licm-parallel-metadata", cl::init(true),
+    cl::desc("Mark loops whose memory accesses cannot depend on each other across iterations as parallel"));
+
+static cl::opt<bool> UnrollHints(
+    "my-licm-unroll-hints", cl::init(false),
+    cl::desc("Add llvm.loop.unroll.count hints from the known or estimated trip count"));
+
+static cl::opt<unsigned> UnrollMaxCount(
+    "my-licm-unroll-max-count", cl::init(8),
+    cl::desc("Largest unroll count -my-licm-unroll-hints suggests"));
+
+static cl::opt<uint64_t> WorkBudget(
+    "my-licm-work-budget", cl::init(0),
+    cl::desc("Loop instructions my-licm may visit in one function before it degrades (0: no limit)"));
+
+static cl::opt<uint64_t> TimeBudget(
+    "my-licm-time-budget-ms", cl::init(0),
+    cl::desc("Milliseconds my-licm may spend on one function before it degrades (0: no limit)"));
+
+static cl::opt<uint64_t> ModuleWorkBudget(
+    "my-licm-module-work-budget", cl::init(0),
+    cl::desc("Loop instructions my-licm may visit in the whole module before it degrades (0: no limit; not with my-opt -j or -cache-dir)"));
+
+static cl::opt<uint64_t> ModuleTimeBudget(
+    "my-licm-module-time-budget-ms", cl::init(0),
+    cl::desc("Milliseconds my-licm may spend on the whole module before it degrades (0: no limit; not with my-opt -j or -cache-dir)"));
+
 namespace {
 struct MyLICMPass : public LoopPass {
   static char ID; // Pass identification, replacement for typeid
@@ -45,6 +88,18 @@ struct MyLICMPass : public LoopPass {
   BasicBlock* NewPreheader;  //newly created preheader
   BasicBlock* NewFirstBlock; //modified landing pad if
   std::unordered_map<BasicBlock*, std::set<BasicBlock*>> Dominators; //dominators map for da
+
+  // cost report state of the function whose loops are being processed
+  Function *ReportF = nullptr;
+  mypassutils::CostSummary ReportBefore;
+  unsigned Hoists = 0;
+  unsigned Sinks = 0;
+
+  // compile-time budget, over it alias analysis gives way to "any write may alias"
+  mypassutils::CompileBudget Budget{"my-licm", {}, {}};
+  Module *BudgetM = nullptr;
+  Function *BudgetF = nullptr;
+
   std::unordered_map<BasicBlock*, std::set<BasicBlock*>> calculateDominators(std::vector<BasicBlock*> Blocks) {
 
     std::unordered_map<BasicBlock*, std::set<BasicBlock*>> Dominators;
@@ -348,8 +403,21 @@ struct MyLICMPass : public LoopPass {
     return true;
   }
 
+  //conservative replacement for the alias checks, any other write in the loop may alias
+  static bool loopWritesMemory(Loop *L, Instruction *except) {
+    for (BasicBlock *BB : L->blocks())
+      for (Instruction &I : *BB)
+        if (&I != except && I.mayWriteToMemory())
+          return true;
+    return false;
+  }
+
   //check for load/store/gep instructions that require special care
   bool specialCheck(Instruction*I,Loop*L) {
+    //with no other writes in the loop the checks below never query alias analysis
+    if (Budget.isDegraded() && !isa<GetElementPtrInst>(I) && loopWritesMemory(L, I))
+      return false;
+
     AAResults& AA= getAnalysis<AAResultsWrapperPass>().getAAResults(); //for alisa check
 
     if (auto *GEP = dyn_cast<GetElementPtrInst>(I)) {
@@ -503,7 +571,321 @@ struct MyLICMPass : public LoopPass {
 
 
 
+  //stack slot used as induction variable the way clang -O0 emits it: promotable,
+  //stored once in the loop, in the latch, with its own value plus a constant
+  struct InductionSlot {
+    AllocaInst *Slot;
+    StoreInst *Increment;
+    int64_t Step;
+  };
+
+  static std::optional<InductionSlot> getInductionSlot(AllocaInst *Slot, Loop *L) {
+    if (!isAllocaPromotable(Slot)) return std::nullopt;
+    StoreInst *Increment = nullptr;
+    for (User *U : Slot->users()) {
+      auto *SI = dyn_cast<StoreInst>(U);
+      if (!SI || !L->contains(SI)) continue;
+      if (Increment) return std::nullopt;
+      Increment = SI;
+    }
+    if (!Increment || Increment->getParent() != L->getLoopLatch()) return std::nullopt;
+
+    //nsw keeps the values of different iterations apart
+    auto *Add = dyn_cast<BinaryOperator>(Increment->getValueOperand());
+    if (!Add || Add->getOpcode() != Instruction::Add || !Add->hasNoSignedWrap()) return std::nullopt;
+    auto *Step = dyn_cast<ConstantInt>(Add->getOperand(1));
+    Value *Prev = Add->getOperand(0);
+    if (!Step) {
+      Step = dyn_cast<ConstantInt>(Add->getOperand(0));
+      Prev = Add->getOperand(1);
+    }
+    auto *PrevLoad = dyn_cast<LoadInst>(Prev);
+    if (!Step || Step->isZero() || !PrevLoad || PrevLoad->getPointerOperand() != Slot) return std::nullopt;
+    return InductionSlot{Slot, Increment, Step->getSExtValue()};
+  }
+
+  //the one store to a stack slot mem2reg will promote, -O0 spills parameters this way
+  static StoreInst *getOnlyStore(AllocaInst *Slot) {
+    if (!isAllocaPromotable(Slot)) return nullptr;
+    StoreInst *Only = nullptr;
+    for (User *U : Slot->users())
+      if (auto *SI = dyn_cast<StoreInst>(U)) {
+        if (Only) return nullptr;
+        Only = SI;
+      }
+    return Only;
+  }
+
+  //pointer that stays the same in every iteration; -O0 reloads it from its slot,
+  //so loads of a slot stored once outside the loop all count as the slot itself
+  static Value *getInvariantBase(Value *Ptr, Loop *L) {
+    if (auto *LI = dyn_cast<LoadInst>(Ptr))
+      if (auto *Slot = dyn_cast<AllocaInst>(LI->getPointerOperand()))
+        if (StoreInst *Only = getOnlyStore(Slot); Only && LI->isSimple() && !L->contains(Only))
+          return Slot;
+    return isDefinedInsideLoop(Ptr, L) ? nullptr : Ptr;
+  }
+
+  //what alias analysis should look at for Ptr: through the slot a base pointer
+  //was spilled to once outside the loop, back to the value stored there (e.g.
+  //a noalias argument); a store inside the loop may change it every iteration
+  static Value *getStoredBase(Value *Ptr, Loop *L) {
+    Value *Base = Ptr;
+    while (auto *GEP = dyn_cast<GEPOperator>(Base))
+      Base = GEP->getPointerOperand();
+    if (auto *LI = dyn_cast<LoadInst>(Base))
+      if (auto *Slot = dyn_cast<AllocaInst>(LI->getPointerOperand()))
+        if (StoreInst *Only = getOnlyStore(Slot); Only && LI->isSimple() && !L->contains(Only))
+          return Only->getValueOperand();
+    return Ptr;
+  }
+
+  //address Base + Scale * IV of a load or store, Scale in bytes per step of IV
+  struct AffineAddress {
+    Value *Base;
+    AllocaInst *IV;
+    int64_t Scale;
+    bool operator==(const AffineAddress &O) const { return Base == O.Base && IV == O.IV && Scale == O.Scale; }
+  };
+
+  static std::optional<AffineAddress> getAffineAddress(Value *Ptr, Loop *L) {
+    auto *GEP = dyn_cast<GetElementPtrInst>(Ptr);
+    if (!GEP || !GEP->isInBounds() || !L->contains(GEP)) return std::nullopt;
+
+    //p[i] and, for arrays, a[0][i]
+    Type *ElemTy = GEP->getSourceElementType();
+    Value *Idx = nullptr;
+    if (GEP->getNumIndices() == 1) {
+      Idx = GEP->getOperand(1);
+    } else if (GEP->getNumIndices() == 2 && ElemTy->isArrayTy() && match(GEP->getOperand(1), PatternMatch::m_Zero())) {
+      Idx = GEP->getOperand(2);
+      ElemTy = ElemTy->getArrayElementType();
+    }
+    if (!Idx || isa<ScalableVectorType>(ElemTy)) return std::nullopt;
+    if (auto *SExt = dyn_cast<SExtInst>(Idx))
+      Idx = SExt->getOperand(0);
+
+    auto *IVLoad = dyn_cast<LoadInst>(Idx);
+    if (!IVLoad || !IVLoad->isSimple() || !L->contains(IVLoad)) return std::nullopt;
+    auto *Slot = dyn_cast<AllocaInst>(IVLoad->getPointerOperand());
+    if (!Slot) return std::nullopt;
+    std::optional<InductionSlot> IV = getInductionSlot(Slot, L);
+    if (!IV) return std::nullopt;
+    //a load after the increment already sees the next iteration's value
+    if (IVLoad->getParent() == IV->Increment->getParent() && IV->Increment->comesBefore(IVLoad))
+      return std::nullopt;
+
+    Value *Base = getInvariantBase(GEP->getPointerOperand(), L);
+    if (!Base) return std::nullopt;
+    const DataLayout &DL = GEP->getModule()->getDataLayout();
+    return AffineAddress{Base, Slot, int64_t(DL.getTypeAllocSize(ElemTy).getFixedValue()) * IV->Step};
+  }
+
+  //memory accesses of the loop if none of them can depend on another one (or
+  //itself) from a different iteration, else nothing. Promotable slots are left
+  //out, mem2reg turns them into registers the vectorizer looks at itself.
+  static std::vector<Instruction*> findParallelAccesses(Loop *L, AAResults &AA) {
+    std::vector<Instruction*> Accesses;
+    for (BasicBlock *BB : L->blocks()) {
+      for (Instruction &I : *BB) {
+        if (!I.mayReadOrWriteMemory()) continue;
+        auto *LI = dyn_cast<LoadInst>(&I);
+        auto *SI = dyn_cast<StoreInst>(&I);
+        if (!(LI && LI->isSimple()) && !(SI && SI->isSimple())) return {}; //calls, atomics, volatile
+        auto *Slot = dyn_cast<AllocaInst>(getLoadStorePointerOperand(&I));
+        if (Slot && isAllocaPromotable(Slot)) continue;
+        Accesses.push_back(&I);
+      }
+    }
+
+    const DataLayout &DL = L->getHeader()->getModule()->getDataLayout();
+    std::vector<std::optional<AffineAddress>> Addresses;
+    for (Instruction *I : Accesses)
+      Addresses.push_back(getAffineAddress(getLoadStorePointerOperand(I), L));
+
+    for (size_t S = 0; S < Accesses.size(); S++) {
+      if (!isa<StoreInst>(Accesses[S])) continue;
+      Value *PtrS = getStoredBase(getLoadStorePointerOperand(Accesses[S]), L);
+      uint64_t SizeS = DL.getTypeStoreSize(getLoadStoreType(Accesses[S])).getFixedValue();
+      for (size_t A = 0; A < Accesses.size(); A++) {
+        //the same element in every iteration, elements far enough apart not to overlap
+        uint64_t SizeA = DL.getTypeStoreSize(getLoadStoreType(Accesses[A])).getFixedValue();
+        if (Addresses[S] && Addresses[A] && *Addresses[S] == *Addresses[A] &&
+            uint64_t(std::abs(Addresses[S]->Scale)) >= std::max(SizeS, SizeA))
+          continue;
+        //unknown sizes cover every iteration (and any offset from the base),
+        //so only different objects are apart
+        Value *PtrA = getStoredBase(getLoadStorePointerOperand(Accesses[A]), L);
+        if (A != S && AA.alias(MemoryLocation::getBeforeOrAfter(PtrS), MemoryLocation::getBeforeOrAfter(PtrA)) ==
+                          AliasResult::NoAlias)
+          continue;
+        return {};
+      }
+    }
+    return Accesses;
+  }
+
+  //trip count of a loop counting a stack slot from a constant to a constant
+  static std::optional<uint64_t> getConstantTripCount(Loop *L) {
+    auto *Br = dyn_cast<BranchInst>(L->getHeader()->getTerminator());
+    if (!Br || !Br->isConditional() || L->contains(Br->getSuccessor(0)) == L->contains(Br->getSuccessor(1)))
+      return std::nullopt;
+    auto *Cmp = dyn_cast<ICmpInst>(Br->getCondition());
+    //pointer (p != end) and vector compares have no integer width
+    if (!Cmp || !Cmp->getOperand(0)->getType()->isIntegerTy() ||
+        Cmp->getOperand(0)->getType()->getIntegerBitWidth() > 32)
+      return std::nullopt;
+    auto *IVLoad = dyn_cast<LoadInst>(Cmp->getOperand(0));
+    auto *Bound = dyn_cast<ConstantInt>(Cmp->getOperand(1));
+    if (!IVLoad || !Bound || IVLoad->getParent() != L->getHeader()) return std::nullopt;
+    auto *Slot = dyn_cast<AllocaInst>(IVLoad->getPointerOperand());
+    std::optional<InductionSlot> IV;
+    if (Slot)
+      IV = getInductionSlot(Slot, L);
+    if (!IV) return std::nullopt;
+
+    //the one store outside the loop sets the start value
+    ConstantInt *Start = nullptr;
+    unsigned Stores = 0;
+    for (User *U : Slot->users())
+      if (auto *SI = dyn_cast<StoreInst>(U); SI && !L->contains(SI)) {
+        Start = dyn_cast<ConstantInt>(SI->getValueOperand());
+        Stores++;
+      }
+    if (Stores != 1 || !Start) return std::nullopt;
+
+    ICmpInst::Predicate Pred = L->contains(Br->getSuccessor(0)) ? Cmp->getPredicate() : Cmp->getInversePredicate();
+    int64_t From = Start->getSExtValue(), To = Bound->getSExtValue(), Step = IV->Step;
+    int64_t Distance;
+    switch (Pred) {
+    case ICmpInst::ICMP_SLT: Distance = To - From; break;
+    case ICmpInst::ICMP_SLE: Distance = To - From + 1; break;
+    case ICmpInst::ICMP_SGT: Distance = To - From; break;
+    case ICmpInst::ICMP_SGE: Distance = To - From - 1; break;
+    case ICmpInst::ICMP_NE:
+      if ((To - From) % Step) return std::nullopt;
+      return (To - From) / Step >= 0 ? std::optional<uint64_t>((To - From) / Step) : std::nullopt;
+    default: return std::nullopt;
+    }
+    //counting towards the bound
+    if ((Pred == ICmpInst::ICMP_SLT || Pred == ICmpInst::ICMP_SLE) != (Step > 0)) return std::nullopt;
+    if (Distance == 0 || (Distance > 0) != (Step > 0)) return 0;
+    return (std::abs(Distance) + std::abs(Step) - 1) / std::abs(Step);
+  }
+
+  //the trip count itself when it is known and small, else the largest power of
+  //two the (estimated) trip count allows; 0 for no hint
+  unsigned getUnrollCount(Loop *L) {
+    std::optional<uint64_t> Exact = getConstantTripCount(L);
+    if (Exact && *Exact <= UnrollMaxCount)
+      return *Exact >= 2 ? *Exact : 0;
+
+    double Estimate = Exact ? double(*Exact) : 0;
+    if (!Exact) {
+      //the loop as it looks now, with the blocks added for hoisting
+      Function &F = *L->getHeader()->getParent();
+      TargetLibraryInfo &TLI = getAnalysis<TargetLibraryInfoWrapperPass>().getTLI(F);
+      DominatorTree DT(F);
+      LoopInfo LI(DT);
+      AssumptionCache AC(F);
+      ScalarEvolution SE(F, TLI, AC, DT, LI);
+      BranchProbabilityInfo BPI(F, LI, &TLI);
+      BlockFrequencyInfo BFI(F, BPI, LI);
+      Loop *Fresh = LI.getLoopFor(L->getHeader());
+      if (!Fresh || Fresh->getHeader() != L->getHeader()) return 0;
+      Estimate = mypassutils::estimateTripCount(*Fresh, SE, BPI, BFI);
+    }
+
+    unsigned Count = 1;
+    while (Count * 2 <= UnrollMaxCount && Count * 2 <= Estimate && (!Exact || *Exact % (Count * 2) == 0))
+      Count *= 2;
+    return Count >= 2 ? Count : 0;
+  }
+
+  static bool hasLoopAttribute(Loop *L, StringRef Prefix) {
+    MDNode *LoopID = L->getLoopID();
+    if (!LoopID) return false;
+    for (unsigned i = 1; i < LoopID->getNumOperands(); i++) {
+      auto *Attr = dyn_cast<MDNode>(LoopID->getOperand(i));
+      if (Attr && Attr->getNumOperands() > 0)
+        if (auto *Name = dyn_cast<MDString>(Attr->getOperand(0)))
+          if (Name->getString().starts_with(Prefix))
+            return true;
+    }
+    return false;
+  }
+
+  //records what the loop's accesses were proven to be as loop metadata, for
+  //the vectorizer (and the unroller) to use instead of finding it out again
+  void annotateLoop(Loop *L) {
+    LLVMContext &Ctx = L->getHeader()->getContext();
+    std::vector<Metadata*> Attributes;
+
+    if (ParallelMetadata && !Budget.isDegraded() && !hasLoopAttribute(L, "llvm.loop.parallel_accesses")) {
+      std::vector<Instruction*> Accesses =
+          findParallelAccesses(L, getAnalysis<AAResultsWrapperPass>().getAAResults());
+      if (!Accesses.empty()) {
+        MDNode *Group = MDNode::getDistinct(Ctx, {});
+        for (Instruction *I : Accesses)
+          I->setMetadata(LLVMContext::MD_access_group,
+                         uniteAccessGroups(I->getMetadata(LLVMContext::MD_access_group), Group));
+        Attributes.push_back(MDNode::get(Ctx, {MDString::get(Ctx, "llvm.loop.parallel_accesses"), Group}));
+        //a vectorize pragma of the source wins
+        if (!hasLoopAttribute(L, "llvm.loop.vectorize."))
+          Attributes.push_back(MDNode::get(Ctx, {MDString::get(Ctx, "llvm.loop.vectorize.enable"),
+                                                 ConstantAsMetadata::get(ConstantInt::getTrue(Ctx))}));
+        mypassutils::passLog() << "Parallel loop: " << L->getHeader()->getName() << "\n";
+      }
+    }
+
+    if (UnrollHints && !hasLoopAttribute(L, "llvm.loop.unroll."))
+      if (unsigned Count = getUnrollCount(L)) {
+        Attributes.push_back(MDNode::get(Ctx, {MDString::get(Ctx, "llvm.loop.unroll.count"),
+                                               ConstantAsMetadata::get(ConstantInt::get(Type::getInt32Ty(Ctx), Count))}));
+        mypassutils::passLog() << "Unroll count " << Count << ": " << L->getHeader()->getName() << "\n";
+      }
+
+    if (Attributes.empty()) return;
+    std::vector<Metadata*> Operands = {nullptr}; //self reference, set below
+    if (MDNode *Old = L->getLoopID())
+      Operands.insert(Operands.end(), Old->op_begin() + 1, Old->op_end());
+    Operands.insert(Operands.end(), Attributes.begin(), Attributes.end());
+    MDNode *LoopID = MDNode::getDistinct(Ctx, Operands);
+    LoopID->replaceOperandWith(0, LoopID);
+    L->setLoopID(LoopID);
+  }
+
+  mypassutils::CostSummary computeCost(Function &F) {
+    return mypassutils::computeCost(F, getAnalysis<TargetTransformInfoWrapperPass>().getTTI(F),
+                                    getAnalysis<TargetLibraryInfoWrapperPass>().getTLI(F));
+  }
+
   bool runOnLoop(Loop *L, LPPassManager &LPM) override {
+    // loops of one function all come before the next function's, so the first
+    // one sees the function as it was
+    Function *F = L->getHeader()->getParent();
+    if (!CostReportFile.empty() && ReportF != F) {
+      ReportF = F;
+      ReportBefore = computeCost(*F);
+      Hoists = Sinks = 0;
+    }
+
+    if (F->getParent() != BudgetM) {
+      BudgetM = F->getParent();
+      Budget = mypassutils::CompileBudget("my-licm", {WorkBudget, TimeBudget}, {ModuleWorkBudget, ModuleTimeBudget});
+      Budget.startModule();
+    }
+    if (BudgetF != F) {
+      BudgetF = F;
+      Budget.startFunction(*F);
+    }
+    // every round below visits the whole loop, the dominators take about as much again
+    unsigned LoopSize = 0;
+    for (BasicBlock *BB : L->blocks())
+      LoopSize += BB->size();
+    if (Budget.charge(2 * LoopSize) == mypassutils::CompileBudget::Exhausted)
+      return false; // nothing changed yet
+
     MappedVars = mapVariables(L);
     // if (L->getLoopPreheader() == nullptr) {
     //   Preheader = makePreheader(L);
@@ -548,24 +930,51 @@ struct MyLICMPass : public LoopPass {
         }
       }
       if (forHoist.size())
-        errs() <<"Hoisting:" << "\n";
+        mypassutils::passLog() <<"Hoisting:" << "\n";
       for (Instruction *I : forHoist) {
-        errs()<<*I<<"    "<<I->getParent()->getName()<<" → "<<NewPreheader->getName() << "\n";
+        mypassutils::passLog()<<*I<<"    "<<I->getParent()->getName()<<" → "<<NewPreheader->getName() << "\n";
         hoistInstruction(I, NewPreheader);
       }
+      Hoists += forHoist.size();
       if (forSink.size())
-        errs() <<"Sinking:" << "\n";
+        mypassutils::passLog() <<"Sinking:" << "\n";
       for (Instruction *I : forSink) {
-        errs()<<*I<<"    "<<I->getParent()->getName()<<" → "<<ExitHeader->getName() << "\n";
+        mypassutils::passLog()<<*I<<"    "<<I->getParent()->getName()<<" → "<<ExitHeader->getName() << "\n";
         sinkInstruction(I, ExitHeader);
       }
+      Sinks += forSink.size();
+
+      //what is hoisted so far stays, the loop is correct after every round
+      if (changed && Budget.charge(LoopSize) == mypassutils::CompileBudget::Exhausted)
+        break;
     }
 
+    annotateLoop(L);
     return true;
   }
+
+  // called once all loops of a function are done
+  bool doFinalization() override {
+    Budget.finishFunction();
+    BudgetF = nullptr;
+    if (ReportF) {
+      mypassutils::CostSummary After = computeCost(*ReportF);
+      mypassutils::appendCostRecord(CostReportFile, "my-licm", *ReportF->getParent(), ReportF->getName(),
+                                    ReportBefore, &After, {{"hoists", Hoists}, {"sinks", Sinks}});
+      ReportF = nullptr;
+    }
+    return false;
+  }
+
   void getAnalysisUsage(AnalysisUsage &AU) const override {
     AU.addRequired<LoopInfoWrapperPass>();
     AU.addRequired<AAResultsWrapperPass>();
+    if (!CostReportFile.empty()) {
+      AU.addRequired<TargetLibraryInfoWrapperPass>();
+      AU.addRequired<TargetTransformInfoWrapperPass>();
+    }
+    if (UnrollHints)
+      AU.addRequired<TargetLibraryInfoWrapperPass>();
   }
 
 }; // end of struct OurLoopInversionPass
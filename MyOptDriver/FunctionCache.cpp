@@ -0,0 +1,108 @@
+#include "FunctionCache.h"
+
+#include "llvm/Support/Chrono.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/WithColor.h"
+
+using namespace llvm;
+
+std::error_code FunctionCache::init() {
+  return sys::fs::create_directories(Dir);
+}
+
+std::string FunctionCache::getKey(ArrayRef<char> Input, ArrayRef<const PassInfo*> Passes) const {
+  MD5 Hash;
+  Hash.update(Salt);
+  for (const PassInfo *PI : Passes) {
+    Hash.update(PI->getPassArgument());
+    Hash.update(StringRef("\0", 1));
+  }
+  Hash.update(StringRef(Input.data(), Input.size()));
+  MD5::MD5Result Result;
+  Hash.final(Result);
+  return Result.digest().str().str();
+}
+
+std::string FunctionCache::getPath(StringRef Key) const {
+  SmallString<128> Path(Dir);
+  sys::path::append(Path, "llvmcache-" + Key);
+  return std::string(Path);
+}
+
+std::unique_ptr<MemoryBuffer> FunctionCache::lookup(StringRef Key) {
+  std::string Path = getPath(Key);
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Entry =
+      MemoryBuffer::getFile(Path, /*IsText=*/false, /*RequiresNullTerminator=*/false);
+  if (!Entry) {
+    ++Stats.Misses;
+    return nullptr;
+  }
+
+  // Pruning evicts by access time, which filesystems mounted noatime never update
+  int FD;
+  if (!sys::fs::openFileForReadWrite(Path, FD, sys::fs::CD_OpenExisting, sys::fs::OF_None)) {
+    sys::fs::setLastAccessAndModificationTime(FD, std::chrono::system_clock::now());
+    sys::Process::SafelyCloseFileDescriptor(FD);
+  }
+
+  ++Stats.Hits;
+  Stats.BytesRead += (*Entry)->getBufferSize();
+  return std::move(*Entry);
+}
+
+void FunctionCache::discard(StringRef Key) {
+  sys::fs::remove(getPath(Key));
+  --Stats.Hits;
+  ++Stats.Misses;
+  ++Stats.Discarded;
+}
+
+void FunctionCache::store(StringRef Key, ArrayRef<char> Bitcode) {
+  // Not named llvmcache-*, so a concurrent prune leaves it alone
+  SmallString<128> Model(Dir);
+  sys::path::append(Model, "tmp-%%%%%%%%%%%%");
+  int FD;
+  SmallString<128> TempPath;
+  std::error_code EC = sys::fs::createUniqueFile(Model, FD, TempPath);
+  if (!EC) {
+    raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    OS.write(Bitcode.data(), Bitcode.size());
+    OS.close();
+    EC = OS.error();
+    if (OS.has_error())
+      OS.clear_error();
+    if (!EC)
+      EC = sys::fs::rename(TempPath, getPath(Key));
+    if (EC)
+      sys::fs::remove(TempPath);
+  }
+
+  if (EC) {
+    // The cache only saves time, the build goes on without it
+    if (!WarnedOnWrite)
+      WithColor::warning() << "cannot write to cache directory " << Dir << ": " << EC.message() << '\n';
+    WarnedOnWrite = true;
+    return;
+  }
+  Stats.BytesWritten += Bitcode.size();
+}
+
+void FunctionCache::prune(const CachePruningPolicy &Policy) {
+  pruneCache(Dir, Policy);
+}
+
+void FunctionCache::printStatistics(raw_ostream &OS) const {
+  unsigned Lookups = Stats.Hits + Stats.Misses;
+  OS << "function cache " << Dir << ": " << Stats.Hits << " hits, " << Stats.Misses << " misses";
+  if (Lookups)
+    OS << format(" (%.1f%% hit rate)", 100.0 * Stats.Hits / Lookups);
+  OS << ", " << Stats.Uncacheable << " functions not cacheable, " << Stats.BytesRead << " bytes read, "
+     << Stats.BytesWritten << " bytes written";
+  if (Stats.Discarded)
+    OS << ", " << Stats.Discarded << " unreadable entries removed";
+  OS << '\n';
+}
@@ -0,0 +1,69 @@
+// On-disk cache of optimized functions for my-opt. Every entry is the bitcode
+// of a module holding one optimized function body, stored in the cache
+// directory as llvmcache-<key>; the key hashes the function's IR (with what
+// it refers to), the passes of the stage, the options that can change their
+// result and the contents of the loaded plugins. Entries are read through
+// MemoryBuffer, so large ones are mapped rather than copied, and pruned
+// least recently used first with LLVM's cache pruning policy. Only the
+// driver's main thread uses it.
+
+#ifndef MY_OPT_DRIVER_FUNCTION_CACHE_H
+#define MY_OPT_DRIVER_FUNCTION_CACHE_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/PassInfo.h"
+#include "llvm/Support/CachePruning.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <memory>
+#include <string>
+#include <system_error>
+
+class FunctionCache {
+public:
+  struct Statistics {
+    unsigned Hits = 0;
+    unsigned Misses = 0;
+    unsigned Uncacheable = 0;
+    unsigned Discarded = 0;
+    uint64_t BytesRead = 0;
+    uint64_t BytesWritten = 0;
+  };
+
+  // Salt goes into every key: whatever outside the function can change the result
+  FunctionCache(llvm::StringRef Dir, std::string Salt) : Dir(Dir.str()), Salt(std::move(Salt)) {}
+
+  // Creates the directory
+  std::error_code init();
+
+  std::string getKey(llvm::ArrayRef<char> Input, llvm::ArrayRef<const llvm::PassInfo*> Passes) const;
+
+  // The stored entry, or null on a miss; a hit marks the entry as just used
+  std::unique_ptr<llvm::MemoryBuffer> lookup(llvm::StringRef Key);
+
+  // Removes an entry lookup returned that turned out unusable; its lookup
+  // counts as a miss
+  void discard(llvm::StringRef Key);
+
+  // Written to a temporary file first and renamed, so concurrent builds
+  // sharing the directory never read half an entry
+  void store(llvm::StringRef Key, llvm::ArrayRef<char> Bitcode);
+
+  void prune(const llvm::CachePruningPolicy &Policy);
+
+  void printStatistics(llvm::raw_ostream &OS) const;
+
+  Statistics Stats;
+
+private:
+  std::string getPath(llvm::StringRef Key) const;
+
+  std::string Dir;
+  std::string Salt;
+  bool WarnedOnWrite = false;
+};
+
+#endif
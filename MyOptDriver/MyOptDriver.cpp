@@ -0,0 +1,432 @@
+// my-opt: runs the plugin passes in one process, on a module parsed once.
+//
+//   my-opt -load lib/MyAlwaysInline.so -load lib/MyInstCombine.so -load lib/LLVMMyLICMPass.so
+//          --pipeline=my-always-inline,my-inst-combine,my-licm --time-passes in.bc -o out.bc
+//
+// Input may be bitcode or textual IR, output is bitcode unless -S is given.
+// -time-passes adds a per-stage timing report, including parsing and writing.
+// With -j, runs of function and loop passes work on parts of the module in
+// parallel, each part in its own context; the parts are merged back in module
+// order, so the output is the same for every thread count, -j 0 included.
+// With -cache-dir, those passes run on one function at a time instead, and a
+// function whose IR, options and plugins are unchanged since an earlier run
+// gets its optimized body from the cache without running them.
+
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassTimingInfo.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/Pass.h"
+#include "llvm/PassInfo.h"
+#include "llvm/PassRegistry.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Parallel.h"
+#include "llvm/Support/PluginLoader.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/SystemUtils.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/WithColor.h"
+#include "llvm/TargetParser/Triple.h"
+
+#include "FunctionCache.h"
+#include "ModuleSplit.h"
+#include "PassLog.h"
+
+#include <optional>
+
+using namespace llvm;
+
+static cl::opt<std::string> InputFilename(cl::Positional, cl::desc("<input bitcode or IR>"),
+                                          cl::init("-"), cl::value_desc("filename"));
+
+static cl::opt<std::string> OutputFilename("o", cl::desc("Output filename"),
+                                           cl::init("-"), cl::value_desc("filename"));
+
+static cl::opt<bool> OutputAssembly("S", cl::desc("Write textual IR instead of bitcode"));
+
+static cl::list<std::string> Pipeline(
+    "pipeline", cl::CommaSeparated, cl::value_desc("pass,pass,..."),
+    cl::desc("Passes to run in order (default: my-always-inline,my-inst-combine,my-licm)"));
+
+static cl::opt<unsigned> Threads(
+    "j", cl::init(0), cl::value_desc("threads"),
+    cl::desc("Run function and loop passes over module parts on this many threads (0: whole module in place)"));
+
+static cl::opt<unsigned> PartSize(
+    "part-size", cl::init(2000),
+    cl::desc("Instructions per module part with -j"));
+
+static cl::opt<bool> NoVerify("disable-verify", cl::desc("Do not verify the module after the pipeline"));
+
+static cl::opt<std::string> CacheDir(
+    "cache-dir", cl::value_desc("directory"),
+    cl::desc("Keep optimized functions in this directory and reuse them for unchanged functions"));
+
+static cl::opt<std::string> CachePolicy(
+    "cache-policy", cl::init("prune_interval=0s:cache_size_bytes=1g"),
+    cl::desc("Pruning policy of -cache-dir, e.g. prune_after=24h:cache_size_bytes=512m"));
+
+static cl::opt<bool> CacheStats("cache-stats", cl::desc("Print function cache hits and misses"));
+
+// my-opt options that never change what the passes produce, with and without
+// a value. -load is covered by hashing the plugins themselves, so moving a
+// build directory keeps the cache.
+static const StringRef ResultNeutralFlags[] = {"S", "disable-verify", "time-passes", "cache-stats"};
+static const StringRef ResultNeutralOptions[] = {"o", "j", "part-size", "cache-dir", "cache-policy", "load"};
+
+// Whatever besides a function's own IR decides what the pipeline makes of it
+static std::string getCacheSalt(int argc, char **argv) {
+  MD5 Hash;
+  auto add = [&](StringRef Data) {
+    Hash.update(Data);
+    Hash.update(StringRef("\0", 1));
+  };
+  add(LLVM_VERSION_STRING);
+
+  for (unsigned I = 0; I < PluginLoader::getNumPlugins(); ++I) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> Plugin = MemoryBuffer::getFile(PluginLoader::getPlugin(I));
+    add(Plugin ? (*Plugin)->getBuffer() : StringRef(PluginLoader::getPlugin(I)));
+  }
+
+  for (int I = 1; I < argc; ++I) {
+    StringRef Arg = argv[I];
+    if (Arg.size() < 2 || !Arg.starts_with("-")) {
+      if (Arg != InputFilename)
+        add(Arg);
+      continue;
+    }
+    StringRef Name = Arg.ltrim('-').split('=').first;
+    if (is_contained(ResultNeutralFlags, Name))
+      continue;
+    if (!is_contained(ResultNeutralOptions, Name)) {
+      add(Arg);
+      continue;
+    }
+    // -o out.bc: the value is the next argument
+    if (!Arg.contains('='))
+      ++I;
+  }
+
+  MD5::MD5Result Result;
+  Hash.final(Result);
+  return Result.digest().str().str();
+}
+
+static void runPasses(Module &M, ArrayRef<const PassInfo*> Passes) {
+  legacy::PassManager PM;
+  PM.add(new TargetLibraryInfoWrapperPass(TargetLibraryInfoImpl(Triple(M.getTargetTriple()))));
+  for (const PassInfo *PI : Passes)
+    PM.add(PI->createPass());
+  PM.run(M);
+}
+
+// Passes that never look past the function or loop they are given can run on parts
+static bool isFunctionLocal(const PassInfo *PI) {
+  std::unique_ptr<Pass> P(PI->createPass());
+  return P->getPassKind() == PT_Function || P->getPassKind() == PT_Loop;
+}
+
+// -<pass>-module-work-budget and -<pass>-module-time-budget-ms of a function
+// or loop pass, if given. On a split module they would count per part, so
+// the output would depend on -part-size and on what is in the cache.
+static std::optional<std::string> getModuleBudgetOption(const PassInfo *PI) {
+  StringMap<cl::Option*> &Options = cl::getRegisteredOptions();
+  for (StringRef Suffix : {"-module-work-budget", "-module-time-budget-ms"}) {
+    std::string Name = (PI->getPassArgument() + Suffix).str();
+    if (cl::Option *O = Options.lookup(Name))
+      if (O->getNumOccurrences())
+        return Name;
+  }
+  return std::nullopt;
+}
+
+// Cuts M into parts of about PartSize instructions, in module order, runs
+// Passes on every part on its own thread and context, then puts the bodies back.
+// Parts depend only on M and PartSize, never on the number of threads.
+static bool runInParts(Module &M, ArrayRef<const PassInfo*> Passes) {
+  std::vector<SmallPtrSet<const Function*, 16>> Parts;
+  unsigned Size = PartSize;
+  for (Function &F : M) {
+    if (F.isDeclaration()) continue;
+    if (Size >= PartSize) {
+      Parts.emplace_back();
+      Size = 0;
+    }
+    Parts.back().insert(&F);
+    Size += F.getInstructionCount();
+  }
+
+  std::vector<SmallVector<char, 0>> Buffers;
+  for (auto &Part : Parts)
+    Buffers.push_back(mypassutils::writeBitcode(*mypassutils::cloneWithBodies(M, Part)));
+
+  // Workers take the next waiting part as soon as they are free. Parts keep
+  // the module's name, which reports written by the passes refer to
+  std::string Name = M.getModuleIdentifier();
+  std::vector<std::string> Errors(Buffers.size()), Logs(Buffers.size());
+  parallel::strategy = hardware_concurrency(Threads);
+  parallelFor(0, Buffers.size(), [&](size_t I) {
+    raw_string_ostream Log(Logs[I]);
+    mypassutils::ScopedPassLog LogScope(Log);
+    LLVMContext Ctx;
+    Expected<std::unique_ptr<Module>> Part = mypassutils::readBitcode(Buffers[I], Name, Ctx);
+    if (!Part) {
+      Errors[I] = toString(Part.takeError());
+      return;
+    }
+    runPasses(**Part, Passes);
+    Buffers[I] = mypassutils::writeBitcode(**Part);
+  });
+
+  for (unsigned I = 0; I < Buffers.size(); ++I) {
+    errs() << Logs[I];
+    if (!Errors[I].empty()) {
+      WithColor::error() << "part " << I << ": " << Errors[I] << '\n';
+      return false;
+    }
+    Expected<std::unique_ptr<Module>> Part = mypassutils::readBitcode(Buffers[I], Name, M.getContext());
+    if (!Part) {
+      WithColor::error() << "part " << I << ": " << toString(Part.takeError()) << '\n';
+      return false;
+    }
+    mypassutils::transplantBodies(M, **Part);
+  }
+  return true;
+}
+
+// Runs Passes on every function of M as its own part, see cloneFunctionAlone.
+// Parts already in Cache are not run again; the rest run on -j threads and
+// are stored. Parts whose entry turns out unreadable run on the main thread
+// and are stored again. Bodies go back in module order, as in runInParts.
+static bool runCached(Module &M, ArrayRef<const PassInfo*> Passes, FunctionCache &Cache) {
+  struct Unit {
+    Function *F;
+    SmallVector<char, 0> Input, Output;
+    std::string Key;
+    std::unique_ptr<MemoryBuffer> Cached;
+    std::string Error, Log;
+  };
+  std::vector<Unit> Units;
+  std::vector<size_t> Todo;
+  for (Function &F : M) {
+    if (F.isDeclaration()) continue;
+    Unit &U = Units.emplace_back();
+    U.F = &F;
+    if (std::unique_ptr<Module> Alone = mypassutils::cloneFunctionAlone(M, F)) {
+      // The key leaves out use-list order, which costs more to write than the
+      // rest of the part; the part that runs keeps it
+      U.Key = Cache.getKey(mypassutils::writeBitcode(*Alone, /*PreserveUseListOrder=*/false), Passes);
+      U.Cached = Cache.lookup(U.Key);
+      if (!U.Cached)
+        U.Input = mypassutils::writeBitcode(*Alone);
+    } else {
+      SmallPtrSet<const Function*, 1> Keep;
+      Keep.insert(&F);
+      U.Input = mypassutils::writeBitcode(*mypassutils::cloneWithBodies(M, Keep));
+      ++Cache.Stats.Uncacheable;
+    }
+    if (!U.Cached)
+      Todo.push_back(Units.size() - 1);
+  }
+
+  std::string Name = M.getModuleIdentifier();
+  auto run = [&](Unit &U) {
+    raw_string_ostream Log(U.Log);
+    mypassutils::ScopedPassLog LogScope(Log);
+    LLVMContext Ctx;
+    Expected<std::unique_ptr<Module>> Part = mypassutils::readBitcode(U.Input, Name, Ctx);
+    if (!Part) {
+      U.Error = toString(Part.takeError());
+      return;
+    }
+    runPasses(**Part, Passes);
+    U.Output = mypassutils::writeBitcode(**Part);
+  };
+  parallel::strategy = hardware_concurrency(std::max(1u, unsigned(Threads)));
+  parallelFor(0, Todo.size(), [&](size_t I) { run(Units[Todo[I]]); });
+
+  for (Unit &U : Units) {
+    std::unique_ptr<Module> Part;
+    if (U.Cached) {
+      // An entry that does not load or lacks the function, written by a build
+      // that was killed or by another LLVM, say, is a miss after all
+      Expected<std::unique_ptr<Module>> Loaded = parseBitcodeFile(U.Cached->getMemBufferRef(), M.getContext());
+      if (Loaded && (*Loaded)->getFunction(U.F->getName()) &&
+          !(*Loaded)->getFunction(U.F->getName())->isDeclaration()) {
+        Part = std::move(*Loaded);
+      } else {
+        consumeError(Loaded.takeError());
+        Cache.discard(U.Key);
+        U.Cached.reset();
+        U.Input = mypassutils::writeBitcode(*mypassutils::cloneFunctionAlone(M, *U.F));
+        run(U);
+      }
+    }
+
+    errs() << U.Log;
+    if (!U.Error.empty()) {
+      WithColor::error() << "function part: " << U.Error << '\n';
+      return false;
+    }
+    if (!U.Cached) {
+      if (!U.Key.empty())
+        Cache.store(U.Key, U.Output);
+      Expected<std::unique_ptr<Module>> Loaded = mypassutils::readBitcode(U.Output, Name, M.getContext());
+      if (!Loaded) {
+        WithColor::error() << "function part: " << toString(Loaded.takeError()) << '\n';
+        return false;
+      }
+      Part = std::move(*Loaded);
+    }
+    mypassutils::transplantBodies(M, *Part);
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  InitLLVM X(argc, argv);
+
+  // Analyses the plugin passes require are created by the pass manager, so
+  // they have to be registered up front, the same way opt does it
+  PassRegistry &Registry = *PassRegistry::getPassRegistry();
+  initializeCore(Registry);
+  initializeAnalysis(Registry);
+  initializeTransformUtils(Registry);
+  initializeScalarOpts(Registry);
+  initializeIPO(Registry);
+
+  // Plugins from -load register their passes and options while parsing
+  cl::ParseCommandLineOptions(argc, argv, "in-process driver for the My* plugin passes\n");
+
+  std::vector<std::string> Stages(Pipeline.begin(), Pipeline.end());
+  if (Stages.empty())
+    Stages = {"my-always-inline", "my-inst-combine", "my-licm"};
+
+  std::vector<const PassInfo*> Passes;
+  for (const std::string &Name : Stages) {
+    const PassInfo *PI = Registry.getPassInfo(Name);
+    if (!PI || !PI->getNormalCtor()) {
+      WithColor::error(errs(), argv[0]) << "unknown pass '" << Name << "', is its plugin loaded with -load?\n";
+      return 1;
+    }
+    Passes.push_back(PI);
+  }
+
+  // Stage timers only exist with -time-passes, TimeRegion ignores a null one
+  TimerGroup Timers("my-opt", "my-opt pipeline stages");
+  std::vector<std::unique_ptr<Timer>> StageTimers;
+  auto stageTimer = [&](StringRef Name) -> Timer * {
+    if (!TimePassesIsEnabled) return nullptr;
+    StageTimers.push_back(std::make_unique<Timer>(Name, Name, Timers));
+    return StageTimers.back().get();
+  };
+
+  std::unique_ptr<FunctionCache> Cache;
+  CachePruningPolicy Policy;
+  if (!CacheDir.empty()) {
+    Expected<CachePruningPolicy> Parsed = parseCachePruningPolicy(CachePolicy);
+    if (!Parsed) {
+      WithColor::error(errs(), argv[0]) << "-cache-policy: " << toString(Parsed.takeError()) << '\n';
+      return 1;
+    }
+    Policy = *Parsed;
+    Cache = std::make_unique<FunctionCache>(CacheDir, getCacheSalt(argc, argv));
+    if (std::error_code EC = Cache->init()) {
+      WithColor::error(errs(), argv[0]) << "cannot create " << CacheDir << ": " << EC.message() << '\n';
+      return 1;
+    }
+  }
+
+  LLVMContext Context;
+  SMDiagnostic Err;
+
+  std::unique_ptr<Module> M;
+  {
+    TimeRegion T(stageTimer("parse"));
+    M = parseIRFile(InputFilename, Err, Context);
+  }
+  if (!M) {
+    Err.print(argv[0], errs());
+    return 1;
+  }
+
+  // One pass manager per stage, so each stage can be timed on its own; with -j
+  // or a cache, consecutive function-local stages share one split run
+  bool Split = Threads || Cache;
+  if (Split)
+    for (const PassInfo *PI : Passes)
+      if (isFunctionLocal(PI))
+        if (std::optional<std::string> Option = getModuleBudgetOption(PI)) {
+          WithColor::error(errs(), argv[0]) << "-" << *Option << " cannot be used with -j or -cache-dir, "
+                                            << "which run " << PI->getPassArgument() << " on parts of the module\n";
+          return 1;
+        }
+  for (unsigned I = 0; I < Passes.size();) {
+    unsigned E = I + 1;
+    if (Split)
+      while (isFunctionLocal(Passes[E - 1]) && E < Passes.size() && isFunctionLocal(Passes[E]))
+        ++E;
+    bool Parallel = Split && isFunctionLocal(Passes[I]);
+
+    std::string Name = Passes[I]->getPassArgument().str();
+    for (unsigned J = I + 1; J < E; ++J)
+      Name += "," + Passes[J]->getPassArgument().str();
+    if (Parallel)
+      Name += Cache ? " (cached)" : " (parallel)";
+
+    TimeRegion T(stageTimer(Name));
+    ArrayRef<const PassInfo*> Stage = ArrayRef<const PassInfo*>(Passes).slice(I, E - I);
+    if (!Parallel)
+      runPasses(*M, Stage);
+    else if (Cache ? !runCached(*M, Stage, *Cache) : !runInParts(*M, Stage))
+      return 1;
+    I = E;
+  }
+
+  if (!NoVerify && verifyModule(*M, &errs())) {
+    WithColor::error(errs(), argv[0]) << "the pipeline produced a broken module\n";
+    return 1;
+  }
+
+  std::error_code EC;
+  auto Out = std::make_unique<ToolOutputFile>(OutputFilename, EC,
+                                              OutputAssembly ? sys::fs::OF_TextWithCRLF : sys::fs::OF_None);
+  if (EC) {
+    WithColor::error(errs(), argv[0]) << EC.message() << '\n';
+    return 1;
+  }
+
+  {
+    TimeRegion T(stageTimer("write"));
+    // Fresh symbol tables make the bitcode the same for every -j
+    if (OutputAssembly)
+      M->print(Out->os(), nullptr);
+    else if (!CheckBitcodeOutputToConsole(Out->os())) {
+      mypassutils::renewSymbolTables(*M);
+      WriteBitcodeToFile(*M, Out->os());
+    }
+  }
+  Out->keep();
+
+  if (Cache) {
+    Cache->prune(Policy);
+    if (CacheStats)
+      Cache->printStatistics(errs());
+  }
+
+  // -time-passes also makes the pass managers report every pass and analysis they ran
+  if (TimePassesIsEnabled)
+    Timers.print(errs(), /*ResetAfterPrint=*/true);
+  return 0;
+}
@@ -0,0 +1,134 @@
+// Compile-time budget of a pass, so one pathological function cannot stall a
+// whole build. Work is counted as instructions visited and as milliseconds
+// spent, for each function and for the module; a limit of 0 means none.
+//
+// A pass works at full strength until a function (or the module) uses up its
+// budget, then degrades to cheaper, conservative analyses until it has used
+// the same amount again, and then leaves the function alone. Both steps are
+// reported as missed-optimization remarks, e.g. -pass-remarks-missed=my-licm.
+// Either way the IR stays correct, it is only optimized less.
+//
+// The module limits count per Module a pass runs on. my-opt -j and
+// -cache-dir run function and loop passes on parts of a module, one
+// function per part with -cache-dir, so my-opt refuses the module limits of
+// those passes there.
+
+#ifndef MY_PASS_UTILS_COMPILE_BUDGET_H
+#define MY_PASS_UTILS_COMPILE_BUDGET_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Analysis/OptimizationRemarkEmitter.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/Function.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+namespace mypassutils {
+
+using namespace llvm;
+
+struct BudgetLimits {
+  uint64_t Instructions = 0;
+  uint64_t Milliseconds = 0;
+};
+
+class CompileBudget {
+public:
+  enum Level { Full, Degraded, Exhausted };
+
+  // PassName names the remarks and has to outlive the budget
+  CompileBudget(const char *PassName, BudgetLimits FunctionLimits, BudgetLimits ModuleLimits)
+      : PassName(PassName), FunctionLimits(FunctionLimits), ModuleLimits(ModuleLimits) {}
+
+  void startModule() {
+    ModuleInstructions = 0;
+    ModuleTime = Clock::duration::zero();
+    ModuleLevel = Full;
+    Current = nullptr;
+  }
+
+  // A module over budget stays so for every function after it
+  void startFunction(Function &F) {
+    finishFunction();
+    Current = &F;
+    FunctionInstructions = 0;
+    FunctionStart = Clock::now();
+    CurrentLevel = Full;
+    raiseTo(ModuleLevel, "module", ModuleInstructions);
+  }
+
+  // Time only counts while a function is worked on: function passes of the
+  // same pass manager run in between
+  void finishFunction() {
+    if (!Current) return;
+    ModuleTime += Clock::now() - FunctionStart;
+    Current = nullptr;
+  }
+
+  // Counts N more instructions visited in the current function
+  Level charge(uint64_t N = 1) {
+    FunctionInstructions += N;
+    ModuleInstructions += N;
+
+    uint64_t FunctionMs = 0, ModuleMs = 0;
+    if (FunctionLimits.Milliseconds || ModuleLimits.Milliseconds) {
+      Clock::duration Spent = Clock::now() - FunctionStart;
+      FunctionMs = std::chrono::duration_cast<std::chrono::milliseconds>(Spent).count();
+      ModuleMs = std::chrono::duration_cast<std::chrono::milliseconds>(ModuleTime + Spent).count();
+    }
+
+    Level FunctionLevel = std::max(levelOf(FunctionInstructions, FunctionLimits.Instructions),
+                                   levelOf(FunctionMs, FunctionLimits.Milliseconds));
+    ModuleLevel = std::max({ModuleLevel, levelOf(ModuleInstructions, ModuleLimits.Instructions),
+                            levelOf(ModuleMs, ModuleLimits.Milliseconds)});
+    if (FunctionLevel >= ModuleLevel)
+      raiseTo(FunctionLevel, "function", FunctionInstructions);
+    else
+      raiseTo(ModuleLevel, "module", ModuleInstructions);
+    return CurrentLevel;
+  }
+
+  Level getLevel() const { return CurrentLevel; }
+  bool isDegraded() const { return CurrentLevel != Full; }
+  bool isExhausted() const { return CurrentLevel == Exhausted; }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  static Level levelOf(uint64_t Used, uint64_t Limit) {
+    if (!Limit || Used < Limit) return Full;
+    return Used < 2 * Limit ? Degraded : Exhausted;
+  }
+
+  void raiseTo(Level New, StringRef Scope, uint64_t Used) {
+    if (New <= CurrentLevel || !Current) return;
+    CurrentLevel = New;
+
+    OptimizationRemarkEmitter ORE(Current);
+    ORE.emit([&] {
+      OptimizationRemarkMissed R(PassName, New == Degraded ? "BudgetDegraded" : "BudgetExhausted",
+                                 DiagnosticLocation(Current->getSubprogram()), &Current->getEntryBlock());
+      R << ore::NV("Function", Current) << ": over the " << ore::NV("Scope", Scope)
+        << " compile-time budget after " << ore::NV("Instructions", Used) << " instructions, "
+        << (New == Degraded ? "switching to cheaper analyses" : "leaving the rest of the function as it is");
+      return R;
+    });
+  }
+
+  const char *PassName;
+  BudgetLimits FunctionLimits, ModuleLimits;
+
+  Function *Current = nullptr;
+  Level CurrentLevel = Full;
+  Level ModuleLevel = Full;
+  uint64_t FunctionInstructions = 0;
+  uint64_t ModuleInstructions = 0;
+  Clock::time_point FunctionStart;
+  Clock::duration ModuleTime = Clock::duration::zero();
+};
+
+} // namespace mypassutils
+
+#endif
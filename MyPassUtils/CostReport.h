@@ -0,0 +1,161 @@
+// Static cost of a function as TargetTransformInfo sees it, for reports that
+// compare a function before and after a pass without running anything.
+// Blocks count once per execution: a loop body is weighted by the trip count
+// SCEV proves, or else by the one block frequencies estimate.
+//
+// Reports are JSON lines, one object per function a pass looked at, appended
+// to the file so several runs (and the parts of one my-opt -j run) can share it:
+//
+//   {"pass":"my-licm","module":"a.ll","function":"foo",
+//    "before":{"throughput":..,"loop_throughput":..,"size":..,"instructions":..},
+//    "after":{..},"delta":{..},"hoists":2,"sinks":1}
+//
+// "after" and "delta" are null when the pass erased the function.
+
+#ifndef MY_PASS_UTILS_COST_REPORT_H
+#define MY_PASS_UTILS_COST_REPORT_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/BranchProbabilityInfo.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <mutex>
+
+namespace mypassutils {
+
+using namespace llvm;
+
+struct CostSummary {
+  double Throughput = 0;     // reciprocal throughput of one call
+  double LoopThroughput = 0; // the part of Throughput spent inside loops
+  double Size = 0;           // code size, every instruction once
+  unsigned Instructions = 0;
+};
+
+// Trip count when neither SCEV nor the block frequencies say anything useful
+const double DefaultTripCount = 10;
+
+// How often the header runs for each entry into the loop
+inline double estimateTripCount(Loop &L, ScalarEvolution &SE, BranchProbabilityInfo &BPI,
+                                BlockFrequencyInfo &BFI) {
+  if (unsigned TC = SE.getSmallConstantTripCount(&L))
+    return TC;
+
+  BasicBlock *Header = L.getHeader();
+  double Entering = 0;
+  for (BasicBlock *Pred : predecessors(Header))
+    if (!L.contains(Pred))
+      Entering += (BFI.getBlockFreq(Pred) * BPI.getEdgeProbability(Pred, Header)).getFrequency();
+  double HeaderFreq = BFI.getBlockFreq(Header).getFrequency();
+  return Entering > 0 && HeaderFreq >= Entering ? HeaderFreq / Entering : DefaultTripCount;
+}
+
+inline double getCostValue(InstructionCost Cost) {
+  return Cost.isValid() ? double(*Cost.getValue()) : 0;
+}
+
+inline CostSummary computeCost(Function &F, const TargetTransformInfo &TTI, TargetLibraryInfo &TLI) {
+  CostSummary Cost;
+  if (F.isDeclaration()) return Cost;
+
+  DominatorTree DT(F);
+  LoopInfo LI(DT);
+  AssumptionCache AC(F);
+  ScalarEvolution SE(F, TLI, AC, DT, LI);
+  BranchProbabilityInfo BPI(F, LI, &TLI);
+  BlockFrequencyInfo BFI(F, BPI, LI);
+
+  DenseMap<Loop*, double> TripCounts;
+  for (Loop *L : LI.getLoopsInPreorder())
+    TripCounts[L] = estimateTripCount(*L, SE, BPI, BFI);
+
+  for (BasicBlock &BB : F) {
+    double Weight = 1;
+    for (Loop *L = LI.getLoopFor(&BB); L; L = L->getParentLoop())
+      Weight *= TripCounts[L];
+
+    for (Instruction &I : BB) {
+      double Throughput = Weight * getCostValue(TTI.getInstructionCost(&I, TargetTransformInfo::TCK_RecipThroughput));
+      Cost.Throughput += Throughput;
+      if (LI.getLoopFor(&BB))
+        Cost.LoopThroughput += Throughput;
+      Cost.Size += getCostValue(TTI.getInstructionCost(&I, TargetTransformInfo::TCK_CodeSize));
+      ++Cost.Instructions;
+    }
+  }
+  return Cost;
+}
+
+inline void writeCost(json::OStream &J, StringRef Key, const CostSummary *Cost) {
+  if (!Cost) {
+    J.attribute(Key, nullptr);
+    return;
+  }
+  J.attributeObject(Key, [&] {
+    J.attribute("throughput", Cost->Throughput);
+    J.attribute("loop_throughput", Cost->LoopThroughput);
+    J.attribute("size", Cost->Size);
+    J.attribute("instructions", int64_t(Cost->Instructions));
+  });
+}
+
+// Appends the record of one function to Filename. After is null if the
+// function is gone; Counts are what the pass did to it, e.g. {"folds", 3}.
+inline void appendCostRecord(StringRef Filename, StringRef Pass, const Module &M, StringRef Function,
+                             const CostSummary &Before, const CostSummary *After,
+                             ArrayRef<std::pair<const char*, unsigned>> Counts) {
+  std::string Line;
+  raw_string_ostream OS(Line);
+  {
+    json::OStream J(OS);
+    J.object([&] {
+      J.attribute("pass", Pass);
+      J.attribute("module", M.getModuleIdentifier());
+      J.attribute("function", Function);
+      writeCost(J, "before", &Before);
+      writeCost(J, "after", After);
+      // A positive loop_throughput delta is what CI looks for: hot loops got slower
+      if (After)
+        J.attributeObject("delta", [&] {
+          J.attribute("throughput", After->Throughput - Before.Throughput);
+          J.attribute("loop_throughput", After->LoopThroughput - Before.LoopThroughput);
+          J.attribute("size", After->Size - Before.Size);
+          J.attribute("instructions", int64_t(After->Instructions) - int64_t(Before.Instructions));
+        });
+      else
+        J.attribute("delta", nullptr);
+      for (auto &Count : Counts)
+        J.attribute(Count.first, int64_t(Count.second));
+    });
+  }
+  OS << '\n';
+  OS.flush();
+
+  // Parts of a module may be optimized on several threads at once
+  static std::mutex Lock;
+  std::lock_guard<std::mutex> Guard(Lock);
+  std::error_code EC;
+  raw_fd_ostream File(Filename, EC, sys::fs::OF_Append | sys::fs::OF_Text);
+  if (EC) {
+    errs() << Pass << ": cannot write cost report " << Filename << ": " << EC.message() << "\n";
+    return;
+  }
+  File << Line;
+}
+
+} // namespace mypassutils
+
+#endif
@@ -0,0 +1,376 @@
+// Helpers for optimizing parts of a module on their own and putting the
+// results back. A part is a copy of the module that keeps the bodies of a
+// chosen set of functions, it travels as bitcode so it can be loaded into a
+// different LLVMContext (one per thread).
+
+#ifndef MY_PASS_UTILS_MODULE_SPLIT_H
+#define MY_PASS_UTILS_MODULE_SPLIT_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+
+#include <optional>
+
+namespace mypassutils {
+
+using namespace llvm;
+
+// Sorts the use lists of everything in the copy of Src to the order they have
+// in Src, passes walking users then meet them in the same order in both.
+// VMap maps Src's values to the copy.
+inline void matchUseLists(const Function &Src, ValueToValueMapTy &VMap) {
+  auto sortLike = [&](const Value &V) {
+    if (V.hasOneUse() || V.use_empty()) return;
+    Value *Copy = VMap.lookup(&V);
+    if (!Copy) return;
+
+    DenseMap<std::pair<User*, unsigned>, unsigned> Position;
+    unsigned I = 0;
+    for (const Use &U : V.uses())
+      if (Value *Copied = VMap.lookup(U.getUser()))
+        Position[std::make_pair(cast<User>(Copied), U.getOperandNo())] = I++;
+    auto getPosition = [&](const Use &U) {
+      auto It = Position.find(std::make_pair(U.getUser(), U.getOperandNo()));
+      return It == Position.end() ? I : It->second;
+    };
+    Copy->sortUseList([&](const Use &L, const Use &R) { return getPosition(L) < getPosition(R); });
+  };
+
+  for (const Argument &A : Src.args())
+    sortLike(A);
+  for (const BasicBlock &BB : Src) {
+    sortLike(BB);
+    for (const Instruction &Inst : BB)
+      sortLike(Inst);
+  }
+}
+
+// Distinct metadata nodes other than compile units that the bodies of Fs
+// refer to, in an order that only depends on the bodies. Debug intrinsics are
+// left out, the same bodies may carry debug records instead.
+inline std::vector<MDNode*> collectDistinctMetadata(ArrayRef<const Function*> Fs) {
+  std::vector<MDNode*> Nodes;
+  SmallPtrSet<const MDNode*, 32> Visited;
+  auto visit = [&](MDNode *Root) {
+    SmallVector<MDNode*, 16> Stack{Root};
+    while (!Stack.empty()) {
+      MDNode *N = Stack.pop_back_val();
+      if (isa<DICompileUnit>(N) || !Visited.insert(N).second) continue;
+      if (N->isDistinct())
+        Nodes.push_back(N);
+      for (const MDOperand &Op : N->operands())
+        if (auto *Child = dyn_cast_or_null<MDNode>(Op.get()))
+          Stack.push_back(Child);
+    }
+  };
+
+  SmallVector<std::pair<unsigned, MDNode*>, 4> MDs;
+  for (const Function *F : Fs) {
+    F->getAllMetadata(MDs);
+    for (auto &MD : MDs)
+      visit(MD.second);
+    for (const Instruction &I : instructions(F)) {
+      if (isa<DbgInfoIntrinsic>(I)) continue;
+      I.getAllMetadata(MDs);
+      for (auto &MD : MDs)
+        visit(MD.second);
+      for (const Value *Op : I.operands())
+        if (auto *MAV = dyn_cast<MetadataAsValue>(Op))
+          if (auto *N = dyn_cast<MDNode>(MAV->getMetadata()))
+            visit(N);
+    }
+  }
+  return Nodes;
+}
+
+// A part lists its copies of collectDistinctMetadata of its source bodies
+// here, so transplantBodies can map them back to the nodes they were copied
+// from instead of making new ones (a second DISubprogram for every inlined
+// callee, say). Null where a node was not copied.
+inline void listDistinctMetadata(Module &Part, ArrayRef<const Function*> Fs, ValueToValueMapTy &VMap) {
+  std::vector<MDNode*> Nodes = collectDistinctMetadata(Fs);
+  if (Nodes.empty()) return;
+  SmallVector<Metadata*, 32> Copies;
+  for (MDNode *N : Nodes) {
+    std::optional<Metadata*> Copy = VMap.getMappedMD(N);
+    Copies.push_back(Copy ? *Copy : nullptr);
+  }
+  Part.getOrInsertNamedMetadata("my.split.distinct")->addOperand(MDTuple::get(Part.getContext(), Copies));
+}
+
+// Copy of M with the bodies of Keep and all global variable initializers
+// (folds may read constant globals), every other function is a declaration
+inline std::unique_ptr<Module> cloneWithBodies(const Module &M, const SmallPtrSetImpl<const Function*> &Keep) {
+  ValueToValueMapTy VMap;
+  std::unique_ptr<Module> Part = CloneModule(M, VMap, [&](const GlobalValue *GV) {
+    if (auto *F = dyn_cast<Function>(GV)) return Keep.count(F) > 0;
+    return isa<GlobalVariable>(GV);
+  });
+  SmallVector<const Function*, 16> Fs;
+  for (const Function &F : M)
+    if (Keep.count(&F)) {
+      Fs.push_back(&F);
+      matchUseLists(F, VMap);
+    }
+  listDistinctMetadata(*Part, Fs, VMap);
+  return Part;
+}
+
+// Creates, for cloneFunctionAlone, the globals of the source module the
+// function refers to, the first time the mapper meets them. Every reference
+// goes through here, also those from metadata and initializers.
+class ReferencedGlobalsMaterializer final : public ValueMaterializer {
+  Module &Part;
+
+public:
+  // Variables whose initializers still have to be mapped
+  SmallVector<std::pair<const GlobalVariable*, GlobalVariable*>, 8> Pending;
+  // Something transplantBodies could not match back by name was used
+  bool Unmatchable = false;
+
+  explicit ReferencedGlobalsMaterializer(Module &Part) : Part(Part) {}
+
+  Value *materialize(Value *V) override {
+    auto *GV = dyn_cast<GlobalValue>(V);
+    if (!GV) return nullptr;
+    if (!GV->hasName())
+      Unmatchable = true;
+
+    // Declarations, as CloneModule makes functions whose bodies it drops
+    if (auto *F = dyn_cast<Function>(GV)) {
+      Function *NF = Function::Create(F->getFunctionType(), GlobalValue::ExternalLinkage,
+                                      F->getAddressSpace(), F->getName(), &Part);
+      NF->copyAttributesFrom(F);
+      NF->setPersonalityFn(nullptr);
+      return NF;
+    }
+    if (auto *G = dyn_cast<GlobalVariable>(GV)) {
+      auto *NG = new GlobalVariable(Part, G->getValueType(), G->isConstant(), G->getLinkage(), nullptr,
+                                    G->getName(), nullptr, G->getThreadLocalMode(),
+                                    G->getType()->getAddressSpace());
+      NG->copyAttributesFrom(G);
+      if (G->hasInitializer())
+        Pending.push_back({G, NG});
+      return NG;
+    }
+    // Aliases and ifuncs are matched by position; the copy is thrown away anyway
+    Unmatchable = true;
+    return Constant::getNullValue(GV->getType());
+  }
+};
+
+inline void copyComdat(GlobalObject &Dst, const GlobalObject &Src) {
+  if (const Comdat *C = Src.getComdat()) {
+    Comdat *Copy = Dst.getParent()->getOrInsertComdat(C->getName());
+    Copy->setSelectionKind(C->getSelectionKind());
+    Dst.setComdat(Copy);
+  }
+}
+
+// Copy of M with F's body and only what it refers to, directly or through
+// initializers and metadata, so the copy stays the same when the rest of M
+// changes. Null if transplantBodies could not match the copy back: F or
+// something it uses is unnamed (matched by position, which the copy does not
+// keep), or an alias or ifunc.
+inline std::unique_ptr<Module> cloneFunctionAlone(const Module &M, const Function &F) {
+  if (!F.hasName()) return nullptr;
+  auto Part = std::make_unique<Module>(M.getModuleIdentifier(), M.getContext());
+  Part->setSourceFileName(M.getSourceFileName());
+  Part->setDataLayout(M.getDataLayout());
+  Part->setTargetTriple(M.getTargetTriple());
+  Part->setModuleInlineAsm(M.getModuleInlineAsm());
+
+  ValueToValueMapTy VMap;
+  ReferencedGlobalsMaterializer Materializer(*Part);
+
+  // The copy shares M's compile units rather than cloning them for every
+  // function; transplantBodies matches them by position in llvm.dbg.cu
+  if (NamedMDNode *CUs = M.getNamedMetadata("llvm.dbg.cu"))
+    for (MDNode *CU : CUs->operands())
+      VMap.MD()[CU].reset(CU);
+  for (const NamedMDNode &NMD : M.named_metadata()) {
+    NamedMDNode *Copy = Part->getOrInsertNamedMetadata(NMD.getName());
+    for (const MDNode *Op : NMD.operands())
+      Copy->addOperand(MapMetadata(Op, VMap, RF_None, nullptr, &Materializer));
+  }
+
+  Function *Copy = Function::Create(F.getFunctionType(), F.getLinkage(), F.getAddressSpace(),
+                                    F.getName(), Part.get());
+  VMap[&F] = Copy;
+  copyComdat(*Copy, F);
+  auto Arg = Copy->arg_begin();
+  for (const Argument &A : F.args()) {
+    Arg->setName(A.getName());
+    VMap[&A] = &*Arg++;
+  }
+  SmallVector<ReturnInst*, 8> Returns;
+  CloneFunctionInto(Copy, &F, VMap, CloneFunctionChangeType::DifferentModule, Returns, "", nullptr, nullptr,
+                    &Materializer);
+  // which always creates the compile unit list
+  if (NamedMDNode *CUs = Part->getNamedMetadata("llvm.dbg.cu"))
+    if (CUs->getNumOperands() == 0)
+      Part->eraseNamedMetadata(CUs);
+
+  // Initializers may name further globals, which land on Pending in turn
+  while (!Materializer.Pending.empty()) {
+    auto [Src, Dst] = Materializer.Pending.pop_back_val();
+    Dst->setInitializer(MapValue(Src->getInitializer(), VMap, RF_None, nullptr, &Materializer));
+    copyComdat(*Dst, *Src);
+    SmallVector<std::pair<unsigned, MDNode*>, 1> MDs;
+    Src->getAllMetadata(MDs);
+    for (auto &MD : MDs)
+      Dst->addMetadata(MD.first, *MapMetadata(MD.second, VMap, RF_None, nullptr, &Materializer));
+  }
+
+  if (Materializer.Unmatchable) return nullptr;
+  matchUseLists(F, VMap);
+  listDistinctMetadata(*Part, &F, VMap);
+  return Part;
+}
+
+// Use-list order is kept, so passes walking users see what they would in
+// memory. Keeping it walks every use of the constants the part refers to,
+// which the whole context shares; callers that only hash a part may skip it.
+inline SmallVector<char, 0> writeBitcode(const Module &M, bool PreserveUseListOrder = true) {
+  SmallVector<char, 0> Buffer;
+  raw_svector_ostream OS(Buffer);
+  WriteBitcodeToFile(M, OS, PreserveUseListOrder);
+  return Buffer;
+}
+
+inline Expected<std::unique_ptr<Module>> readBitcode(const SmallVectorImpl<char> &Buffer, StringRef Name,
+                                                     LLVMContext &Ctx) {
+  return parseBitcodeFile(MemoryBufferRef(StringRef(Buffer.data(), Buffer.size()), Name), Ctx);
+}
+
+// Replaces the body of each function Part defines with that definition. Part
+// must be a cloneWithBodies or cloneFunctionAlone copy of M, loaded into M's
+// context. Globals are matched by name; a cloneWithBodies copy keeps every
+// global in its place, so unnamed ones are matched by their position, and a
+// cloneFunctionAlone copy has none. Declarations the passes added are
+// created in M. Debug info keeps M's
+// compile units, subprograms and other distinct nodes the part copied.
+// Functions are visited in module order, so the result does not depend on
+// which part finished first.
+inline void transplantBodies(Module &M, Module &Part) {
+  ValueToValueMapTy VMap;
+
+  auto Dst = M.global_begin();
+  for (GlobalVariable &GV : Part.globals()) {
+    GlobalValue *Match = GV.hasName() ? M.getNamedValue(GV.getName())
+                                      : Dst != M.global_end() ? &*Dst : nullptr;
+    VMap[&GV] = Match ? Match : M.getOrInsertGlobal(GV.getName(), GV.getValueType());
+    if (Dst != M.global_end()) ++Dst;
+  }
+
+  SmallVector<std::pair<Function*, Function*>, 16> Bodies;
+  auto DstF = M.begin();
+  for (Function &F : Part) {
+    GlobalValue *Match = F.hasName() ? M.getNamedValue(F.getName())
+                                     : DstF != M.end() ? &*DstF : nullptr;
+    if (DstF != M.end()) ++DstF;
+    if (!Match) {
+      VMap[&F] = M.getOrInsertFunction(F.getName(), F.getFunctionType(), F.getAttributes()).getCallee();
+      continue;
+    }
+    VMap[&F] = Match;
+    if (!F.isDeclaration())
+      Bodies.push_back({cast<Function>(Match), &F});
+  }
+
+  auto DstA = M.alias_begin();
+  for (GlobalAlias &GA : Part.aliases())
+    if (DstA != M.alias_end())
+      VMap[&GA] = &*DstA++;
+  auto DstI = M.ifunc_begin();
+  for (GlobalIFunc &GI : Part.ifuncs())
+    if (DstI != M.ifunc_end())
+      VMap[&GI] = &*DstI++;
+
+  // Debug info of the whole module stays M's own, only the bodies are new
+  NamedMDNode *PartCUs = Part.getNamedMetadata("llvm.dbg.cu");
+  NamedMDNode *CUs = M.getNamedMetadata("llvm.dbg.cu");
+  if (PartCUs && CUs)
+    for (unsigned I = 0, E = std::min(PartCUs->getNumOperands(), CUs->getNumOperands()); I != E; ++I)
+      VMap.MD()[PartCUs->getOperand(I)].reset(CUs->getOperand(I));
+
+  // Distinct nodes the part listed go back to those of the old bodies
+  if (NamedMDNode *Listed = Part.getNamedMetadata("my.split.distinct")) {
+    SmallVector<const Function*, 16> Fs;
+    for (auto &Entry : Bodies)
+      Fs.push_back(Entry.first);
+    std::vector<MDNode*> Nodes = collectDistinctMetadata(Fs);
+    MDNode *Copies = Listed->getOperand(0);
+    if (Copies->getNumOperands() == Nodes.size())
+      for (unsigned I = 0; I != Nodes.size(); ++I)
+        if (Metadata *Copy = Copies->getOperand(I))
+          VMap.MD()[Copy].reset(Nodes[I]);
+  }
+
+  for (auto &Entry : Bodies) {
+    Function &F = *Entry.first, &Src = *Entry.second;
+    if (DISubprogram *SP = F.getSubprogram())
+      if (DISubprogram *SrcSP = Src.getSubprogram())
+        VMap.MD()[SrcSP].reset(SP);
+
+    // deleteBody also makes the function external, keep what it was
+    GlobalValue::LinkageTypes Linkage = F.getLinkage();
+    Comdat *C = F.getComdat();
+    F.deleteBody();
+    F.setLinkage(Linkage);
+    F.setComdat(C);
+
+    auto Arg = F.arg_begin();
+    for (Argument &A : Src.args())
+      VMap[&A] = &*Arg++;
+
+    SmallVector<ReturnInst*, 8> Returns;
+    CloneFunctionInto(&F, &Src, VMap, CloneFunctionChangeType::DifferentModule, Returns);
+    matchUseLists(Src, VMap);
+  }
+
+  // Cloning into another module always creates the compile unit list
+  if (!CUs)
+    if (NamedMDNode *NewCUs = M.getNamedMetadata("llvm.dbg.cu"))
+      if (NewCUs->getNumOperands() == 0)
+        M.eraseNamedMetadata(NewCUs);
+}
+
+// Moves every body into a new function that takes the old one's place. The
+// bitcode writer lists a function's local names in the order of its symbol
+// table, a hash table whose layout depends on every name the function ever
+// had; a new table holds only the current names, added in the same order
+// whether the body was optimized in place or transplanted from a part.
+inline void renewSymbolTables(Module &M) {
+  for (Function &F : make_early_inc_range(M)) {
+    if (F.isDeclaration()) continue;
+    Function *NF = Function::Create(F.getFunctionType(), F.getLinkage(), F.getAddressSpace(), "", &M);
+    M.getFunctionList().splice(F.getIterator(), M.getFunctionList(), NF->getIterator());
+    NF->copyAttributesFrom(&F);
+    NF->setComdat(F.getComdat());
+    NF->copyMetadata(&F, 0);
+    NF->takeName(&F);
+    NF->splice(NF->begin(), &F);
+    for (auto [A, NA] : zip(F.args(), NF->args())) {
+      NA.takeName(&A);
+      A.replaceAllUsesWith(&NA);
+    }
+    F.replaceAllUsesWith(NF);
+    F.eraseFromParent();
+  }
+}
+
+} // namespace mypassutils
+
+#endif
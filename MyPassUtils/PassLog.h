@@ -0,0 +1,36 @@
+// Progress lines the passes print, e.g. "Hoisting:" from my-licm. They go to
+// errs(), unless the thread running the pass was given a log of its own:
+// my-opt -j runs parts of a module on several threads at once and prints
+// every part's lines after the part, in module order.
+
+#ifndef MY_PASS_UTILS_PASS_LOG_H
+#define MY_PASS_UTILS_PASS_LOG_H
+
+#include "llvm/Support/raw_ostream.h"
+
+namespace mypassutils {
+
+using namespace llvm;
+
+// A variable rather than a static inside passLog(), so the driver and the
+// plugins it loads share it (inline functions may be hidden in each of them)
+inline thread_local raw_ostream *ThreadPassLog = nullptr;
+
+inline raw_ostream &passLog() {
+  return ThreadPassLog ? *ThreadPassLog : errs();
+}
+
+// Sends the current thread's pass log to OS while in scope
+class ScopedPassLog {
+  raw_ostream *Saved;
+
+public:
+  explicit ScopedPassLog(raw_ostream &OS) : Saved(ThreadPassLog) { ThreadPassLog = &OS; }
+  ~ScopedPassLog() { ThreadPassLog = Saved; }
+  ScopedPassLog(const ScopedPassLog &) = delete;
+  ScopedPassLog &operator=(const ScopedPassLog &) = delete;
+};
+
+} // namespace mypassutils
+
+#endif
@@ -0,0 +1,499 @@
+// my-run: executes a module and its optimized version side by side and checks
+// that they compute the same thing.
+//
+//   my-run --repeat=10 -o results.csv base.ll base.my-licm.ll
+//
+// Every function both modules define whose parameters are integers or
+// pointers and whose result is an integer (or void) is called on a fixed set
+// of arguments; kernel_main() style entry points with no parameters are
+// called once per sample. Pointer parameters point to scratch buffers of
+// small integers, one per parameter. Results, the buffers and the module's
+// writable globals are compared call by call, the exit code is 1 on any
+// difference; functions that cannot be called are listed. Each function is then
+// timed --repeat times in both versions, alternating between them, and the
+// median wall clock time with its relative spread is reported together with
+// user-space cycles and instructions from perf_event where the kernel allows it.
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ExecutionEngine/MCJIT.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/WithColor.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace llvm;
+
+static cl::opt<std::string> BaselineFilename(cl::Positional, cl::Required, cl::desc("<baseline IR>"));
+
+static cl::opt<std::string> OptimizedFilename(cl::Positional, cl::Required, cl::desc("<optimized IR>"));
+
+static cl::opt<std::string> OutputFilename("o", cl::desc("Output filename"),
+                                           cl::init("-"), cl::value_desc("filename"));
+
+static cl::opt<unsigned> Repeat("repeat", cl::init(5), cl::desc("Timed samples per function and version"));
+
+static cl::opt<unsigned> InputSets("input-sets", cl::init(4),
+                                   cl::desc("Argument sets every function with parameters is called on"));
+
+static cl::opt<unsigned> Timeout("timeout", cl::init(60), cl::desc("Seconds before the whole run is killed (0: none)"));
+
+static cl::opt<unsigned> BufferBytes("buffer-bytes", cl::init(4096),
+                                     cl::desc("Size of the buffer every pointer parameter points to"));
+
+static cl::opt<bool> NoHeader("no-header", cl::desc("Do not write the CSV header line"));
+
+// Small values, so loops bounded by an argument stay short and array-free code
+// does not overflow into undefined behaviour the two versions may treat differently
+static const int64_t ArgumentValues[] = {3, 1, 7, 0, 12, 5, 2, 9};
+
+static int64_t getArgument(unsigned Set, unsigned Arg) {
+  return ArgumentValues[(Set * 3 + Arg) % std::size(ArgumentValues)];
+}
+
+static bool isIntegerOrVoid(Type *Ty) {
+  return Ty->isVoidTy() || (Ty->isIntegerTy() && Ty->getIntegerBitWidth() <= 64);
+}
+
+static bool isRunnableParameter(Type *Ty) {
+  return (Ty->isIntegerTy() && Ty->getIntegerBitWidth() <= 64) ||
+         (Ty->isPointerTy() && Ty->getPointerAddressSpace() == 0);
+}
+
+static bool isCallable(const Function &F) {
+  return isIntegerOrVoid(F.getReturnType()) && !F.isVarArg() && F.arg_size() <= 64 &&
+         all_of(F.args(), [](const Argument &A) { return isRunnableParameter(A.getType()); });
+}
+
+// Signatures live in different contexts, so they are compared by shape
+static bool haveSameSignature(const Function &L, const Function &R) {
+  auto getWidth = [](Type *Ty) {
+    return Ty->isVoidTy() ? 0u : Ty->isPointerTy() ? ~0u : Ty->getIntegerBitWidth();
+  };
+  if (L.arg_size() != R.arg_size() || getWidth(L.getReturnType()) != getWidth(R.getReturnType()))
+    return false;
+  for (unsigned I = 0; I < L.arg_size(); ++I)
+    if (getWidth(L.getArg(I)->getType()) != getWidth(R.getArg(I)->getType()))
+      return false;
+  return true;
+}
+
+// Whether values of Ty hold an address anywhere in them
+static bool containsPointer(Type *Ty) {
+  if (Ty->isPointerTy()) return true;
+  if (auto *ATy = dyn_cast<ArrayType>(Ty)) return containsPointer(ATy->getElementType());
+  if (auto *VTy = dyn_cast<VectorType>(Ty)) return containsPointer(VTy->getElementType());
+  if (auto *STy = dyn_cast<StructType>(Ty)) return any_of(STy->elements(), containsPointer);
+  return false;
+}
+
+// Globals whose contents are compared after every call: writable, defined in
+// both versions with the same type, and holding no addresses, which differ
+// between the two programs anyway
+static std::vector<std::string> getComparedGlobals(Module &Base, Module &Opt) {
+  std::vector<std::string> Names;
+  for (GlobalVariable &GV : Base.globals()) {
+    GlobalVariable *Other = Opt.getGlobalVariable(GV.getName(), /*AllowInternal=*/true);
+    if (!GV.hasName() || GV.isConstant() || GV.isDeclaration() || !Other || Other->isConstant() ||
+        Other->isDeclaration() || containsPointer(GV.getValueType()) ||
+        Base.getDataLayout().getTypeAllocSize(GV.getValueType()) !=
+            Opt.getDataLayout().getTypeAllocSize(Other->getValueType()))
+      continue;
+    Names.push_back(GV.getName().str());
+  }
+  return Names;
+}
+
+// Adds i64 @__my_run.<name>(ptr %args): loads the arguments, narrows them to
+// F's parameter types (pointers are passed as addresses) and returns F's
+// result sign-extended to i64. Calling the wrapper through one fixed C
+// signature keeps every call ABI-correct.
+static void createWrapper(Function &F) {
+  Module &M = *F.getParent();
+  LLVMContext &Ctx = M.getContext();
+  IRBuilder<> B(Ctx);
+  FunctionType *FTy = FunctionType::get(B.getInt64Ty(), {PointerType::get(Ctx, 0)}, false);
+  Function *W = Function::Create(FTy, GlobalValue::ExternalLinkage, "__my_run." + F.getName(), M);
+  B.SetInsertPoint(BasicBlock::Create(Ctx, "entry", W));
+
+  SmallVector<Value*, 8> Args;
+  for (Argument &A : F.args()) {
+    Value *Slot = B.CreateConstGEP1_32(B.getInt64Ty(), W->getArg(0), A.getArgNo());
+    Value *Arg = B.CreateLoad(B.getInt64Ty(), Slot);
+    Args.push_back(A.getType()->isPointerTy() ? B.CreateIntToPtr(Arg, A.getType())
+                                              : B.CreateTrunc(Arg, A.getType()));
+  }
+  CallInst *Call = B.CreateCall(&F, Args);
+  Call->setAttributes(F.getAttributes());
+  Call->setCallingConv(F.getCallingConv());
+  B.CreateRet(F.getReturnType()->isVoidTy() ? B.getInt64(0) : B.CreateSExt(Call, B.getInt64Ty()));
+}
+
+namespace {
+using Entry = int64_t (*)(const int64_t *);
+
+// One version of the program, compiled by MCJIT in its own context
+struct Program {
+  LLVMContext Ctx;
+  std::unique_ptr<ExecutionEngine> EE;
+  Module *M = nullptr;
+
+  bool load(StringRef Filename, const char *Argv0) {
+    SMDiagnostic Err;
+    std::unique_ptr<Module> Owner = parseIRFile(Filename, Err, Ctx);
+    if (!Owner) {
+      Err.print(Argv0, errs());
+      return false;
+    }
+    M = Owner.get();
+    std::string Error;
+    EE.reset(EngineBuilder(std::move(Owner)).setEngineKind(EngineKind::JIT).setErrorStr(&Error).create());
+    if (!EE) {
+      WithColor::error(errs(), Argv0) << Filename << ": " << Error << '\n';
+      return false;
+    }
+    return true;
+  }
+
+  Entry getEntry(StringRef Name) {
+    return reinterpret_cast<Entry>(EE->getFunctionAddress(("__my_run." + Name).str()));
+  }
+
+  // Internal globals are not in the engine's symbol table until they are external
+  void exposeGlobals(ArrayRef<std::string> Names) {
+    for (const std::string &Name : Names) {
+      GlobalVariable *GV = M->getGlobalVariable(Name, /*AllowInternal=*/true);
+      if (GV->hasLocalLinkage())
+        GV->setLinkage(GlobalValue::ExternalLinkage);
+      Globals.push_back({Name, 0, M->getDataLayout().getTypeAllocSize(GV->getValueType())});
+    }
+  }
+
+  // Call once the engine is finalized
+  void findGlobals() {
+    for (Global &G : Globals)
+      G.Address = EE->getGlobalValueAddress(G.Name);
+  }
+
+  // FNV-1a of each compared global, in the order exposeGlobals was given
+  std::vector<uint64_t> hashGlobals() const {
+    std::vector<uint64_t> Hashes;
+    for (const Global &G : Globals) {
+      uint64_t Hash = 14695981039346656037ull;
+      const auto *Bytes = reinterpret_cast<const unsigned char *>(G.Address);
+      for (uint64_t I = 0; Bytes && I < G.Size; ++I)
+        Hash = (Hash ^ Bytes[I]) * 1099511628211ull;
+      Hashes.push_back(Hash);
+    }
+    return Hashes;
+  }
+
+  struct Global {
+    std::string Name;
+    uint64_t Address;
+    uint64_t Size;
+  };
+  std::vector<Global> Globals;
+};
+
+// User-space cycles and instructions of this thread, where perf_event_open is
+// allowed (perf_event_paranoid, containers); otherwise available() is false
+class PerfCounters {
+  int Fds[2] = {-1, -1};
+
+public:
+  PerfCounters() {
+#ifdef __linux__
+    const uint64_t Configs[2] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS};
+    for (unsigned I = 0; I < 2; ++I) {
+      perf_event_attr Attr;
+      memset(&Attr, 0, sizeof(Attr));
+      Attr.type = PERF_TYPE_HARDWARE;
+      Attr.size = sizeof(Attr);
+      Attr.config = Configs[I];
+      Attr.disabled = 1;
+      Attr.exclude_kernel = 1;
+      Attr.exclude_hv = 1;
+      Fds[I] = syscall(SYS_perf_event_open, &Attr, 0, -1, -1, 0);
+    }
+#endif
+  }
+
+  ~PerfCounters() {
+#ifdef __linux__
+    for (int Fd : Fds)
+      if (Fd >= 0) close(Fd);
+#endif
+  }
+
+  bool available() const { return Fds[0] >= 0 && Fds[1] >= 0; }
+
+  void start() {
+#ifdef __linux__
+    if (!available()) return;
+    for (int Fd : Fds) {
+      ioctl(Fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(Fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  void stop(double &Cycles, double &Instructions) {
+    Cycles = Instructions = 0;
+#ifdef __linux__
+    if (!available()) return;
+    uint64_t Counts[2] = {0, 0};
+    for (unsigned I = 0; I < 2; ++I) {
+      ioctl(Fds[I], PERF_EVENT_IOC_DISABLE, 0);
+      if (read(Fds[I], &Counts[I], sizeof(uint64_t)) != sizeof(uint64_t))
+        Counts[I] = 0;
+    }
+    Cycles = Counts[0];
+    Instructions = Counts[1];
+#endif
+  }
+};
+
+struct Samples {
+  std::vector<double> Nanoseconds, Cycles, Instructions;
+};
+
+struct RunTarget {
+  std::string Name;
+  unsigned Arity;
+  uint64_t PointerArgs; // bit N set: parameter N is a pointer
+  bool ReturnsValue;
+  Entry Base, Opt;
+};
+
+// Arguments of one call; each pointer parameter gets a buffer of its own
+struct CallArgs {
+  int64_t Values[64];
+  std::vector<std::vector<int32_t>> Memory;
+};
+} // namespace
+
+static double median(std::vector<double> Values) {
+  if (Values.empty()) return 0;
+  llvm::sort(Values);
+  size_t Mid = Values.size() / 2;
+  return Values.size() % 2 ? Values[Mid] : (Values[Mid - 1] + Values[Mid]) / 2;
+}
+
+// Standard deviation relative to the mean, in percent
+static double relativeSpread(const std::vector<double> &Values) {
+  if (Values.size() < 2) return 0;
+  double Mean = 0, Sq = 0;
+  for (double V : Values) Mean += V;
+  Mean /= Values.size();
+  for (double V : Values) Sq += (V - Mean) * (V - Mean);
+  return Mean ? 100 * std::sqrt(Sq / (Values.size() - 1)) / Mean : 0;
+}
+
+static unsigned getCalls(const RunTarget &T) { return T.Arity ? unsigned(InputSets) : 1; }
+
+// Buffers hold small integers, so loads see plausible sizes and indices, with
+// a zero every 13 words that ends strings
+static void prepareCall(const RunTarget &T, unsigned Set, CallArgs &C) {
+  C.Memory.clear();
+  for (unsigned A = 0; A < T.Arity; ++A) {
+    if (!(T.PointerArgs >> A & 1)) {
+      C.Values[A] = getArgument(Set, A);
+      continue;
+    }
+    std::vector<int32_t> &Buffer = C.Memory.emplace_back(std::max(1u, unsigned(BufferBytes) / 4));
+    for (size_t I = 0; I < Buffer.size(); ++I)
+      Buffer[I] = int32_t((I * 7 + Set + A) % 13);
+    C.Values[A] = int64_t(reinterpret_cast<intptr_t>(Buffer.data()));
+  }
+}
+
+// One sample: every argument set once, buffers are filled before the clock starts
+static void sample(const RunTarget &T, Entry E, PerfCounters &Perf, Samples &S) {
+  std::vector<CallArgs> Calls(getCalls(T));
+  for (unsigned Set = 0; Set < Calls.size(); ++Set)
+    prepareCall(T, Set, Calls[Set]);
+  double Cycles, Instructions;
+  auto Start = std::chrono::steady_clock::now();
+  Perf.start();
+  for (CallArgs &C : Calls)
+    E(C.Values);
+  Perf.stop(Cycles, Instructions);
+  auto End = std::chrono::steady_clock::now();
+  S.Nanoseconds.push_back(std::chrono::duration<double, std::nano>(End - Start).count());
+  S.Cycles.push_back(Cycles);
+  S.Instructions.push_back(Instructions);
+}
+
+int main(int argc, char **argv) {
+  InitLLVM X(argc, argv);
+  InitializeNativeTarget();
+  InitializeNativeTargetAsmPrinter();
+  InitializeNativeTargetAsmParser();
+
+  cl::ParseCommandLineOptions(argc, argv, "runs a module and its optimized version and compares them\n");
+
+  Program Base, Opt;
+  if (!Base.load(BaselineFilename, argv[0]) || !Opt.load(OptimizedFilename, argv[0]))
+    return 1;
+  if (verifyModule(*Opt.M, &errs())) {
+    WithColor::error(errs(), argv[0]) << OptimizedFilename << ": broken module\n";
+    return 1;
+  }
+
+  // Wrappers and exposed globals have to exist before the engines compile anything
+  std::vector<RunTarget> Targets;
+  unsigned Skipped = 0;
+  // The wrappers are added to the modules as we go, and take a pointer
+  std::vector<Function*> Functions;
+  for (Function &F : *Base.M)
+    if (!F.isDeclaration() && !F.isIntrinsic() && F.hasName())
+      Functions.push_back(&F);
+  for (Function *Fn : Functions) {
+    Function &F = *Fn;
+    Function *G = Opt.M->getFunction(F.getName());
+    const char *Reason = nullptr;
+    if (!isCallable(F))
+      Reason = "parameter or result types it cannot pass";
+    else if (!G || G->isDeclaration())
+      Reason = "it is gone after optimization";
+    else if (!isCallable(*G) || !haveSameSignature(F, *G))
+      Reason = "its signature changed";
+    if (Reason) {
+      WithColor::note(errs(), argv[0]) << "not running " << F.getName() << ": " << Reason << '\n';
+      ++Skipped;
+      continue;
+    }
+    createWrapper(F);
+    createWrapper(*G);
+    uint64_t PointerArgs = 0;
+    for (Argument &A : F.args())
+      if (A.getType()->isPointerTy())
+        PointerArgs |= uint64_t(1) << A.getArgNo();
+    Targets.push_back({F.getName().str(), unsigned(F.arg_size()), PointerArgs, !F.getReturnType()->isVoidTy(),
+                       nullptr, nullptr});
+  }
+  std::vector<std::string> GlobalNames = getComparedGlobals(*Base.M, *Opt.M);
+  Base.exposeGlobals(GlobalNames);
+  Opt.exposeGlobals(GlobalNames);
+  WithColor::note(errs(), argv[0]) << BaselineFilename << ": running " << Targets.size() << " functions, " << Skipped << " skipped, comparing "
+         << GlobalNames.size() << " globals\n";
+  if (Targets.empty()) {
+    WithColor::warning(errs(), argv[0]) << BaselineFilename << ": no function with a signature it can call\n";
+    return 0;
+  }
+
+#ifdef __linux__
+  // A miscompiled loop must not hang the harness
+  if (Timeout)
+    alarm(Timeout);
+#endif
+
+  for (Program *P : {&Base, &Opt})
+    P->EE->runStaticConstructorsDestructors(false);
+  for (RunTarget &T : Targets) {
+    T.Base = Base.getEntry(T.Name);
+    T.Opt = Opt.getEntry(T.Name);
+  }
+  Base.findGlobals();
+  Opt.findGlobals();
+
+  // Both versions see the same sequence of calls, so functions that keep state
+  // in globals stay comparable
+  bool Mismatch = false;
+  std::vector<bool> Correct;
+  for (const RunTarget &T : Targets) {
+    bool Ok = true;
+    for (unsigned Set = 0; Set < getCalls(T); ++Set) {
+      CallArgs BaseCall, OptCall;
+      prepareCall(T, Set, BaseCall);
+      prepareCall(T, Set, OptCall);
+      int64_t Expected = T.Base(BaseCall.Values);
+      std::vector<uint64_t> ExpectedGlobals = Base.hashGlobals();
+      int64_t Got = T.Opt(OptCall.Values);
+      std::vector<uint64_t> GotGlobals = Opt.hashGlobals();
+
+      auto report = [&]() -> raw_ostream & {
+        WithColor::error(errs(), argv[0]) << T.Name << "(";
+        for (unsigned A = 0; A < T.Arity; ++A) {
+          errs() << (A ? ", " : "");
+          if (T.PointerArgs >> A & 1)
+            errs() << "<buffer>";
+          else
+            errs() << BaseCall.Values[A];
+        }
+        Ok = false;
+        return errs() << ") ";
+      };
+      if (T.ReturnsValue && Expected != Got)
+        report() << "returned " << Got << " after optimization, " << Expected << " before\n";
+      for (unsigned B = 0; B < BaseCall.Memory.size(); ++B)
+        if (BaseCall.Memory[B] != OptCall.Memory[B])
+          report() << "left different contents in pointer argument buffer " << B << " after optimization\n";
+      for (unsigned G = 0; G < GlobalNames.size(); ++G)
+        if (ExpectedGlobals[G] != GotGlobals[G])
+          report() << "left different contents in global " << GlobalNames[G] << " after optimization\n";
+    }
+    Correct.push_back(Ok);
+    Mismatch |= !Ok;
+  }
+
+  std::error_code EC;
+  ToolOutputFile Out(OutputFilename, EC, sys::fs::OF_TextWithCRLF);
+  if (EC) {
+    WithColor::error(errs(), argv[0]) << EC.message() << '\n';
+    return 1;
+  }
+  raw_ostream &OS = Out.os();
+  if (!NoHeader)
+    OS << "function,status,calls,base_ns,base_rsd_pct,opt_ns,opt_rsd_pct,speedup,"
+          "base_cycles,opt_cycles,base_instructions,opt_instructions\n";
+
+  PerfCounters Perf;
+  if (!Perf.available())
+    WithColor::note(errs(), argv[0]) << "perf_event is not available, cycle and instruction counts are left empty\n";
+
+  for (unsigned I = 0; I < Targets.size(); ++I) {
+    const RunTarget &T = Targets[I];
+    Samples BaseS, OptS;
+    // Alternating keeps slow drift (frequency scaling, other load) out of the ratio
+    for (unsigned R = 0; R < std::max(1u, unsigned(Repeat)); ++R) {
+      sample(T, T.Base, Perf, BaseS);
+      sample(T, T.Opt, Perf, OptS);
+    }
+
+    double BaseNs = median(BaseS.Nanoseconds), OptNs = median(OptS.Nanoseconds);
+    OS << T.Name << ',' << (Correct[I] ? "ok" : "mismatch") << ',' << getCalls(T) << ','
+       << format("%.0f,%.1f,%.0f,%.1f,%.3f", BaseNs, relativeSpread(BaseS.Nanoseconds), OptNs,
+                 relativeSpread(OptS.Nanoseconds), OptNs ? BaseNs / OptNs : 0.0);
+    if (Perf.available())
+      OS << format(",%.0f,%.0f,%.0f,%.0f", median(BaseS.Cycles), median(OptS.Cycles),
+                   median(BaseS.Instructions), median(OptS.Instructions));
+    else
+      OS << ",,,,";
+    OS << '\n';
+  }
+  Out.keep();
+  return Mismatch ? 1 : 0;
+}
@@ -0,0 +1,61 @@
+// hash.c: FNV-1a and a multiplicative mix over a byte buffer, plus a small open-addressing table
+#define LEN 262144
+#define SLOTS 4096
+
+static unsigned char data[LEN];
+static unsigned table[SLOTS];
+
+static void init(void) {
+    unsigned x = 2463534242u;
+    for (int i = 0; i < LEN; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        data[i] = x & 0xff;
+    }
+}
+
+static unsigned fnv1a(const unsigned char *p, int n) {
+    unsigned h = 2166136261u;
+    for (int i = 0; i < n; i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static unsigned mix(const unsigned char *p, int n, unsigned seed) {
+    unsigned h = seed;
+    unsigned k = seed * 2 + 1; // invariant multiplier
+    for (int i = 0; i + 4 <= n; i += 4) {
+        unsigned w = p[i] | p[i + 1] << 8 | p[i + 2] << 16 | (unsigned)p[i + 3] << 24;
+        h = (h ^ w * k) * 0x9e3779b1u;
+        h = h << 13 | h >> 19;
+    }
+    return h;
+}
+
+static int insert_all(const unsigned char *p, int n) {
+    int probes = 0;
+    for (int i = 0; i + 8 <= n; i += 8) {
+        unsigned key = fnv1a(p + i, 8) | 1;
+        unsigned slot = key & (SLOTS - 1);
+        while (table[slot] != 0 && table[slot] != key) {
+            slot = (slot + 1) & (SLOTS - 1);
+            probes++;
+        }
+        table[slot] = key;
+    }
+    return probes;
+}
+
+int kernel_main(void) {
+    init();
+    for (int i = 0; i < SLOTS; i++) {
+        table[i] = 0;
+    }
+    unsigned a = fnv1a(data, LEN);
+    unsigned b = mix(data, LEN, 7);
+    int probes = insert_all(data, 4 * SLOTS);
+    return (int)((a ^ b) + (unsigned)probes);
+}
@@ -0,0 +1,37 @@
+// matmul.c: dense integer matrix multiply, naive i-j-k order
+#define N 96
+
+static int A[N][N], B[N][N], C[N][N];
+
+static void init(void) {
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < N; j++) {
+            A[i][j] = (i * 7 + j * 3) % 17 - 8;
+            B[i][j] = (i * 5 + j * 11) % 13 - 6;
+        }
+    }
+}
+
+static void multiply(int n) {
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            int sum = 0;
+            for (int k = 0; k < n; k++) {
+                sum += A[i][k] * B[k][j]; // A[i] and B are invariant in k
+            }
+            C[i][j] = sum;
+        }
+    }
+}
+
+int kernel_main(void) {
+    init();
+    multiply(N);
+    unsigned checksum = 0;
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < N; j++) {
+            checksum = checksum * 31 + C[i][j];
+        }
+    }
+    return (int)checksum;
+}
@@ -0,0 +1,60 @@
+// strscan.c: scanning a text buffer for words, a character class and a pattern
+#define LEN 65536
+
+static char text[LEN + 1];
+
+static void init(void) {
+    const char *words[] = {"loop ", "invariant ", "hoist ", "combine ", "inline ", "\n"};
+    unsigned seed = 12345;
+    int pos = 0;
+    while (pos < LEN) {
+        seed = seed * 1103515245u + 12345u;
+        const char *w = words[(seed >> 16) % 6];
+        while (*w && pos < LEN) {
+            text[pos++] = *w++;
+        }
+    }
+    text[LEN] = '\0';
+}
+
+static int count_words(const char *s) {
+    int words = 0;
+    int in_word = 0;
+    for (int i = 0; s[i] != '\0'; i++) {
+        int space = s[i] == ' ' || s[i] == '\n';
+        if (!space && !in_word) {
+            words++;
+        }
+        in_word = !space;
+    }
+    return words;
+}
+
+static int count_vowels(const char *s, int n) {
+    int vowels = 0;
+    for (int i = 0; i < n; i++) {
+        char c = s[i] | 0x20; // lower case, the same in every iteration
+        vowels += c == 'a' || c == 'e' || c == 'i' || c == 'o' || c == 'u';
+    }
+    return vowels;
+}
+
+static int count_pattern(const char *s, int n, const char *p, int m) {
+    int found = 0;
+    for (int i = 0; i + m <= n; i++) {
+        int j = 0;
+        while (j < m && s[i + j] == p[j]) {
+            j++;
+        }
+        found += j == m;
+    }
+    return found;
+}
+
+int kernel_main(void) {
+    init();
+    int words = count_words(text);
+    int vowels = count_vowels(text, LEN);
+    int hoists = count_pattern(text, LEN, "hoist", 5);
+    return (int)((unsigned)words * 1000003u + (unsigned)vowels * 101u + (unsigned)hoists);
+}
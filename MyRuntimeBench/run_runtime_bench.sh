@@ -0,0 +1,101 @@
+#!/bin/bash
+# Compiles every test input and kernel, optimizes it with each plugin pass and
+# runs both versions with my-run, which checks they return the same values and
+# leave the same memory behind, and times them. Results go to <out>/runtime.csv; exits non-zero if any pass fails
+# or changes a result.
+#
+#   MyRuntimeBench/run_runtime_bench.sh --clang build/bin/clang --opt build/bin/opt \
+#       --my-run build/bin/my-run --plugins build/lib --out build/runtime-bench
+#
+# Without file arguments it takes LICM_tests/*.c, instcombine_tests/*.ll and
+# MyRuntimeBench/kernels/*.c. C files are compiled the way LICM_test.sh does it.
+set -uo pipefail
+shopt -s nullglob
+
+ROOT="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+CLANG=clang
+OPT=opt
+MY_RUN=my-run
+PLUGINS=lib
+OUT=runtime-bench
+REPEAT=5
+
+# pass:plugin library
+PASSES=(
+  "my-always-inline:MyAlwaysInline.so"
+  "my-inst-combine:MyInstCombine.so"
+  "my-licm:LLVMMyLICMPass.so"
+)
+
+while [ $# -gt 0 ]; do
+  case "$1" in
+    --clang) CLANG="$2"; shift 2 ;;
+    --opt) OPT="$2"; shift 2 ;;
+    --my-run) MY_RUN="$2"; shift 2 ;;
+    --plugins) PLUGINS="$2"; shift 2 ;;
+    --out) OUT="$2"; shift 2 ;;
+    --repeat) REPEAT="$2"; shift 2 ;;
+    --) shift; break ;;
+    -*) echo "unknown option $1" >&2; exit 2 ;;
+    *) break ;;
+  esac
+done
+
+INPUTS=("$@")
+if [ ${#INPUTS[@]} -eq 0 ]; then
+  INPUTS=("$ROOT"/LICM_tests/*.c "$ROOT"/instcombine_tests/*.ll "$ROOT"/MyRuntimeBench/kernels/*.c)
+fi
+
+mkdir -p "$OUT"
+CSV="$OUT/runtime.csv"
+echo "input,pass,function,status,calls,base_ns,base_rsd_pct,opt_ns,opt_rsd_pct,speedup,base_cycles,opt_cycles,base_instructions,opt_instructions" > "$CSV"
+failed=0
+
+for src in "${INPUTS[@]}"; do
+  name=$(basename "$src")
+  name="${name%.*}"
+  dir="$OUT/$name"
+  mkdir -p "$dir"
+  base="$dir/$name.ll"
+
+  case "$src" in
+    *.c)
+      if ! "$CLANG" -S -emit-llvm -Xclang -disable-O0-optnone "$src" -o "$base" 2>"$dir/clang.log"; then
+        echo "✗ $name: clang failed, see $dir/clang.log"
+        failed=1
+        continue
+      fi ;;
+    *) cp "$src" "$base" ;;
+  esac
+
+  for entry in "${PASSES[@]}"; do
+    pass="${entry%%:*}"
+    plugin="$PLUGINS/${entry#*:}"
+    optimized="$dir/$name.$pass.ll"
+
+    if ! "$OPT" -S -load "$plugin" --bugpoint-enable-legacy-pm "-$pass" "$base" -o "$optimized" \
+         >"$dir/$pass.opt.log" 2>&1; then
+      echo "✗ $name: $pass failed, see $dir/$pass.opt.log"
+      echo "$name,$pass,,opt-failed,,,,,,,,,," >> "$CSV"
+      failed=1
+      continue
+    fi
+
+    # Programs may print, my-run writes its rows to a file of their own
+    rm -f "$dir/$pass.csv"
+    "$MY_RUN" --repeat="$REPEAT" --no-header -o "$dir/$pass.csv" "$base" "$optimized" \
+      >"$dir/$pass.stdout" 2>"$dir/$pass.run.log"
+    status=$?
+    [ -f "$dir/$pass.csv" ] && sed "s|^|$name,$pass,|" "$dir/$pass.csv" >> "$CSV"
+    if [ $status -ne 0 ]; then
+      echo "✗ $name: $pass changed the results, see $dir/$pass.run.log"
+      [ -s "$dir/$pass.csv" ] || echo "$name,$pass,,run-failed,,,,,,,,,," >> "$CSV"
+      failed=1
+    else
+      echo "✓ $name: $pass"
+    fi
+  done
+done
+
+echo "Results in $CSV"
+exit $failed
@@ -0,0 +1,58 @@
+#!/bin/bash
+# Runs every inline_tests/*.ll through the passes named in its comments and
+# checks the output and the log (stderr), exits non-zero if anything is
+# missing or left over or the output does not verify:
+#   ; passes: -my-always-inline -my-inline-mode=cost
+#   ; expect: call i32 @rec(
+#   ; expect-not: call i32 @leaf(
+#   ; expect-log: switching to cheaper analyses
+# Without a passes line the test runs -my-always-inline. %S in the passes
+# stands for the directory of the test, for files it reads next to it.
+shopt -s nullglob dotglob
+
+SRC_DIR="./build/inline_tests"
+OPT="./build/bin/opt"
+PLUGIN="./build/lib/MyAlwaysInline.so"
+FAILED=0
+
+for src in "$SRC_DIR"/*.ll; do
+	# outputs of an earlier run
+	[[ "$src" == *_after.ll ]] && continue
+	base=$(basename "$src" .ll)
+	out="$SRC_DIR/${base}_after.ll"
+	passes=$(sed -n 's|^; passes: ||p' "$src")
+	passes="${passes:--my-always-inline}"
+	read -r -a flags <<< "${passes//%S/$SRC_DIR}"
+
+	echo "Compiling $base"
+	if ! "$OPT" --load "$PLUGIN" --bugpoint-enable-legacy-pm "${flags[@]}" -S "$src" -o "$out" 2>"$SRC_DIR/$base.log"; then
+		echo "❌ $base: opt failed, see $SRC_DIR/$base.log"
+		FAILED=1
+		continue
+	fi
+	if ! "$OPT" -passes=verify -disable-output "$out" 2>>"$SRC_DIR/$base.log"; then
+		echo "❌ $base: $out does not verify, see $SRC_DIR/$base.log"
+		FAILED=1
+	fi
+
+	while IFS= read -r line; do
+		if ! grep -qF -- "$line" "$out"; then
+			echo "❌ $base: expected \"$line\" in $out"
+			FAILED=1
+		fi
+	done < <(sed -n 's|^; expect: ||p' "$src")
+	while IFS= read -r line; do
+		if grep -qF -- "$line" "$out"; then
+			echo "❌ $base: did not expect \"$line\" in $out"
+			FAILED=1
+		fi
+	done < <(sed -n 's|^; expect-not: ||p' "$src")
+	while IFS= read -r line; do
+		if ! grep -qF -- "$line" "$SRC_DIR/$base.log"; then
+			echo "❌ $base: expected \"$line\" in $SRC_DIR/$base.log"
+			FAILED=1
+		fi
+	done < <(sed -n 's|^; expect-log: ||p' "$src")
+done
+
+exit $FAILED
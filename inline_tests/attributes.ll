@@ -0,0 +1,43 @@
+; Test file for the attributes of callers after inlining
+; Attributes the caller already had stay, and what the inlined bodies now
+; show about it is added: no unwinding, no recursion, the memory it touches
+; expect: define i32 @pure(ptr noalias nonnull %p, i32 %x)
+; expect: memory(none)
+; expect: memory(read)
+; expect: norecurse nounwind
+; expect-not: call i32 @twice(
+; expect-not: call i32 @load_g(
+
+@g = global i32 0
+
+define i32 @pure(ptr noalias nonnull %p, i32 %x) {
+entry:
+  ; only touches its own stack once twice is inlined, should not access memory
+  %r = call i32 @twice(i32 %x)
+  ret i32 %r
+}
+
+define internal i32 @twice(i32 %x) #0 {
+entry:
+  %t = alloca i32, align 4
+  store i32 %x, ptr %t, align 4
+  %v = load i32, ptr %t, align 4
+  %r = shl i32 %v, 1
+  ret i32 %r
+}
+
+define i32 @reader(i32 %x) {
+entry:
+  ; reads @g once load_g is inlined, should only read memory
+  %g = call i32 @load_g()
+  %r = add i32 %g, %x
+  ret i32 %r
+}
+
+define internal i32 @load_g() #0 {
+entry:
+  %v = load i32, ptr @g, align 4
+  ret i32 %v
+}
+
+attributes #0 = { alwaysinline }
@@ -0,0 +1,50 @@
+; Test file for the attributes of weak and linkonce callers after inlining
+; The linker may replace their bodies, so what the inlined bodies show about
+; this definition says nothing about the one other callers end up calling
+; expect: define weak i32 @weak_pure(i32 %x) {
+; expect: define linkonce_odr ptr @odr_addr(i32 %x) {
+; expect-not: nounwind
+; expect-not: norecurse
+; expect-not: memory(
+; expect-not: call i32 @twice(
+; expect-not: call ptr @addr_g(
+
+@g = global i32 0
+
+define weak i32 @weak_pure(i32 %x) {
+entry:
+  ; only touches its own stack once twice is inlined, but may be interposed
+  %r = call i32 @twice(i32 %x)
+  ret i32 %r
+}
+
+define linkonce_odr ptr @odr_addr(i32 %x) {
+entry:
+  ; returns @g once addr_g is inlined, but may be interposed
+  %p = call ptr @addr_g()
+  ret ptr %p
+}
+
+define i32 @user(i32 %x) {
+entry:
+  %a = call i32 @weak_pure(i32 %x)
+  %p = call ptr @odr_addr(i32 %x)
+  store i32 %a, ptr %p, align 4
+  ret i32 %a
+}
+
+define internal i32 @twice(i32 %x) #0 {
+entry:
+  %t = alloca i32, align 4
+  store i32 %x, ptr %t, align 4
+  %v = load i32, ptr %t, align 4
+  %r = shl i32 %v, 1
+  ret i32 %r
+}
+
+define internal ptr @addr_g() #0 {
+entry:
+  ret ptr @g
+}
+
+attributes #0 = { alwaysinline }
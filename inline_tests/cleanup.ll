@@ -0,0 +1,43 @@
+; Test file for the cleanup of freshly inlined bodies
+; Constant arguments decide branches and arithmetic in the inlined copy;
+; those are folded, the blocks they cut off removed, and the caller's own
+; instruction using the inlined result is simplified with them
+; expect-not: call void @slow_path(i32 %x)
+; expect-not: br i1 true
+; expect-not: br i1 false
+; expect-not: %d = sub
+; expect: ret i32 32
+; expect: call void @slow_path(i32 %y)
+
+declare void @slow_path(i32)
+
+define i32 @caller(i32 %x) {
+entry:
+  ; (x + 8 * 4) - x
+  %r = call i32 @step(i32 %x, i32 8, i1 true)
+  %d = sub i32 %r, %x
+  ret i32 %d
+}
+
+define i32 @unknown_mode(i32 %y, i1 %fast) {
+entry:
+  ; nothing is known about fast here, the slow path must stay
+  %r = call i32 @step(i32 %y, i32 8, i1 %fast)
+  ret i32 %r
+}
+
+define internal i32 @step(i32 %x, i32 %k, i1 %fast) #0 {
+entry:
+  br i1 %fast, label %fast.path, label %slow
+
+fast.path:
+  %scaled = mul i32 %k, 4
+  %r = add i32 %x, %scaled
+  ret i32 %r
+
+slow:
+  call void @slow_path(i32 %x)
+  ret i32 %x
+}
+
+attributes #0 = { alwaysinline }
@@ -0,0 +1,29 @@
+; Test file for the growth budgets of -my-inline-mode=cost
+; Each callee is cheap enough, but a caller may only grow by 4 instructions,
+; so only one of the two calls is inlined; the other caller has its own budget
+; passes: -my-always-inline -my-inline-mode=cost -my-inline-caller-budget=4
+; expect: %a = call i32 @mix(i32 %x)
+; expect-not: %b = call i32 @mix(i32 %y)
+; expect-not: %c = call i32 @mix(i32 %z)
+
+define i32 @caller(i32 %x, i32 %y) {
+entry:
+  %a = call i32 @mix(i32 %x)
+  %b = call i32 @mix(i32 %y)
+  %r = add i32 %a, %b
+  ret i32 %r
+}
+
+define i32 @other(i32 %z) {
+entry:
+  %c = call i32 @mix(i32 %z)
+  ret i32 %c
+}
+
+define i32 @mix(i32 %x) {
+entry:
+  %m = mul i32 %x, 31
+  %s = lshr i32 %m, 7
+  %r = xor i32 %m, %s
+  ret i32 %r
+}
@@ -0,0 +1,115 @@
+; Test file for -my-inline-mode=cost
+; Small callees are inlined without alwaysinline, those the cost model finds
+; too big stay calls
+; passes: -my-always-inline -my-inline-mode=cost
+; expect-not: call i32 @square(
+; expect-not: call i32 @clamp(
+; expect: %b = call i32 @big(i32 %x)
+
+define i32 @caller(i32 %x) {
+entry:
+  %s = call i32 @square(i32 %x)
+  %c = call i32 @clamp(i32 %s, i32 100)
+  ; about 80 instructions, over the default threshold of 225
+  %b = call i32 @big(i32 %x)
+  %r = add i32 %c, %b
+  ret i32 %r
+}
+
+define i32 @square(i32 %x) {
+entry:
+  %r = mul i32 %x, %x
+  ret i32 %r
+}
+
+define i32 @clamp(i32 %x, i32 %hi) {
+entry:
+  %over = icmp sgt i32 %x, %hi
+  %r = select i1 %over, i32 %hi, i32 %x
+  ret i32 %r
+}
+
+define i32 @big(i32 %x) {
+entry:
+  %v0 = mul i32 %x, 3
+  %v1 = xor i32 %v0, 10
+  %v2 = add i32 %v1, 17
+  %v3 = sub i32 %v2, 24
+  %v4 = mul i32 %v3, 31
+  %v5 = xor i32 %v4, 38
+  %v6 = add i32 %v5, 45
+  %v7 = sub i32 %v6, 52
+  %v8 = mul i32 %v7, 59
+  %v9 = xor i32 %v8, 66
+  %v10 = add i32 %v9, 73
+  %v11 = sub i32 %v10, 80
+  %v12 = mul i32 %v11, 87
+  %v13 = xor i32 %v12, 94
+  %v14 = add i32 %v13, 101
+  %v15 = sub i32 %v14, 108
+  %v16 = mul i32 %v15, 115
+  %v17 = xor i32 %v16, 122
+  %v18 = add i32 %v17, 129
+  %v19 = sub i32 %v18, 136
+  %v20 = mul i32 %v19, 143
+  %v21 = xor i32 %v20, 150
+  %v22 = add i32 %v21, 157
+  %v23 = sub i32 %v22, 164
+  %v24 = mul i32 %v23, 171
+  %v25 = xor i32 %v24, 178
+  %v26 = add i32 %v25, 185
+  %v27 = sub i32 %v26, 192
+  %v28 = mul i32 %v27, 199
+  %v29 = xor i32 %v28, 206
+  %v30 = add i32 %v29, 213
+  %v31 = sub i32 %v30, 220
+  %v32 = mul i32 %v31, 227
+  %v33 = xor i32 %v32, 234
+  %v34 = add i32 %v33, 241
+  %v35 = sub i32 %v34, 248
+  %v36 = mul i32 %v35, 255
+  %v37 = xor i32 %v36, 262
+  %v38 = add i32 %v37, 269
+  %v39 = sub i32 %v38, 276
+  %v40 = mul i32 %v39, 283
+  %v41 = xor i32 %v40, 290
+  %v42 = add i32 %v41, 297
+  %v43 = sub i32 %v42, 304
+  %v44 = mul i32 %v43, 311
+  %v45 = xor i32 %v44, 318
+  %v46 = add i32 %v45, 325
+  %v47 = sub i32 %v46, 332
+  %v48 = mul i32 %v47, 339
+  %v49 = xor i32 %v48, 346
+  %v50 = add i32 %v49, 353
+  %v51 = sub i32 %v50, 360
+  %v52 = mul i32 %v51, 367
+  %v53 = xor i32 %v52, 374
+  %v54 = add i32 %v53, 381
+  %v55 = sub i32 %v54, 388
+  %v56 = mul i32 %v55, 395
+  %v57 = xor i32 %v56, 402
+  %v58 = add i32 %v57, 409
+  %v59 = sub i32 %v58, 416
+  %v60 = mul i32 %v59, 423
+  %v61 = xor i32 %v60, 430
+  %v62 = add i32 %v61, 437
+  %v63 = sub i32 %v62, 444
+  %v64 = mul i32 %v63, 451
+  %v65 = xor i32 %v64, 458
+  %v66 = add i32 %v65, 465
+  %v67 = sub i32 %v66, 472
+  %v68 = mul i32 %v67, 479
+  %v69 = xor i32 %v68, 486
+  %v70 = add i32 %v69, 493
+  %v71 = sub i32 %v70, 500
+  %v72 = mul i32 %v71, 507
+  %v73 = xor i32 %v72, 514
+  %v74 = add i32 %v73, 521
+  %v75 = sub i32 %v74, 528
+  %v76 = mul i32 %v75, 535
+  %v77 = xor i32 %v76, 542
+  %v78 = add i32 %v77, 549
+  %v79 = sub i32 %v78, 556
+  ret i32 %v79
+}
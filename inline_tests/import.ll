@@ -0,0 +1,34 @@
+; Test file for -my-inline-import
+; alwaysinline definitions of declared callees are imported from another
+; file, inlined and dropped again: helper brings in helper2, taken keeps its
+; declaration for the pointer to it. Callees without alwaysinline, or that
+; refer to something local to their file, stay calls.
+; passes: -my-always-inline -my-inline-import=%S/import/helpers.ll
+; expect-not: call i32 @helper(
+; expect-not: @helper2
+; expect-not: call i32 @taken(
+; expect: declare i32 @taken(i32)
+; expect-not: available_externally
+; expect: %n = call i32 @not_inline(i32 %x)
+; expect: declare i32 @not_inline(i32)
+; expect: %u = call i32 @uses_local(i32 1)
+; expect: declare i32 @uses_local(i32)
+; expect-not: @table
+
+@fp = global ptr @taken
+
+declare i32 @helper(i32)
+declare i32 @taken(i32)
+declare i32 @not_inline(i32)
+declare i32 @uses_local(i32)
+
+define i32 @caller(i32 %x) {
+entry:
+  %h = call i32 @helper(i32 %x)
+  %t = call i32 @taken(i32 %h)
+  %n = call i32 @not_inline(i32 %x)
+  %u = call i32 @uses_local(i32 1)
+  %s1 = add i32 %t, %n
+  %r = add i32 %s1, %u
+  ret i32 %r
+}
@@ -0,0 +1,37 @@
+; Definitions import.ll imports, another translation unit as far as it knows
+
+@table = internal constant [2 x i32] [i32 3, i32 5]
+
+define i32 @helper(i32 %x) #0 {
+entry:
+  %h = call i32 @helper2(i32 %x)
+  %r = add i32 %h, 1
+  ret i32 %r
+}
+
+define i32 @helper2(i32 %x) #0 {
+entry:
+  %r = mul i32 %x, 7
+  ret i32 %r
+}
+
+define i32 @taken(i32 %x) #0 {
+entry:
+  %r = sub i32 %x, 2
+  ret i32 %r
+}
+
+define i32 @not_inline(i32 %x) {
+entry:
+  %r = xor i32 %x, 9
+  ret i32 %r
+}
+
+define i32 @uses_local(i32 %i) #0 {
+entry:
+  %p = getelementptr [2 x i32], ptr @table, i32 0, i32 %i
+  %r = load i32, ptr %p, align 4
+  ret i32 %r
+}
+
+attributes #0 = { alwaysinline }
@@ -0,0 +1,91 @@
+; Test file for -my-partial-inline
+; A callee that returns early on its hot path gets that guard inlined and the
+; rest outlined into a cold function. Callees whose slow path is the hot one,
+; and callees the linker may replace (weak, linkonce), stay calls.
+; passes: -my-always-inline -my-partial-inline
+; expect: call void @split.cold(
+; expect: define internal void @split.cold(
+; expect-not: %s = call i32 @split(i32 %x)
+; expect-not: @split.guard
+; expect: %h = call i32 @hot_slow(i32 %x)
+; expect-not: @hot_slow.cold
+; expect: %w = call i32 @weak_split(i32 %x)
+; expect-not: @weak_split.cold
+
+declare i32 @expensive(i32)
+
+define i32 @caller(i32 %x) {
+entry:
+  %s = call i32 @split(i32 %x)
+  %h = call i32 @hot_slow(i32 %x)
+  %w = call i32 @weak_split(i32 %x)
+  %t = add i32 %s, %h
+  %r = add i32 %t, %w
+  ret i32 %r
+}
+
+; The early exit is taken 100 times for every slow call
+define i32 @split(i32 %x) {
+entry:
+  %fast = icmp slt i32 %x, 16
+  br i1 %fast, label %ret, label %slow, !prof !0
+
+slow:
+  %a = mul i32 %x, %x
+  %b = add i32 %a, 7
+  %c = call i32 @expensive(i32 %b)
+  br label %more
+
+more:
+  %d = mul i32 %c, %x
+  br label %ret
+
+ret:
+  %r = phi i32 [ %x, %entry ], [ %d, %more ]
+  ret i32 %r
+}
+
+; The slow path is the hot one, nothing to gain from inlining the guard
+define i32 @hot_slow(i32 %x) {
+entry:
+  %fast = icmp slt i32 %x, 16
+  br i1 %fast, label %ret, label %slow, !prof !1
+
+slow:
+  %a = mul i32 %x, %x
+  %b = add i32 %a, 7
+  %c = call i32 @expensive(i32 %b)
+  br label %more
+
+more:
+  %d = mul i32 %c, %x
+  br label %ret
+
+ret:
+  %r = phi i32 [ %x, %entry ], [ %d, %more ]
+  ret i32 %r
+}
+
+; Shaped and weighted like split, but another definition may win at link time
+define weak i32 @weak_split(i32 %x) {
+entry:
+  %fast = icmp slt i32 %x, 16
+  br i1 %fast, label %ret, label %slow, !prof !0
+
+slow:
+  %a = mul i32 %x, %x
+  %b = add i32 %a, 7
+  %c = call i32 @expensive(i32 %b)
+  br label %more
+
+more:
+  %d = mul i32 %c, %x
+  br label %ret
+
+ret:
+  %r = phi i32 [ %x, %entry ], [ %d, %more ]
+  ret i32 %r
+}
+
+!0 = !{!"branch_weights", i32 100, i32 1}
+!1 = !{!"branch_weights", i32 1, i32 100}
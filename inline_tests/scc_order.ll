@@ -0,0 +1,76 @@
+; Test file for the bottom-up call graph walk of my-always-inline
+; Chains of alwaysinline callees are flattened in one run, whatever order the
+; module lists them in, and recursive callees are found without function-attrs
+; expect-not: call i32 @middle(
+; expect-not: call i32 @leaf(
+; expect-not: define internal i32 @leaf(
+; expect: %c = call i32 @countdown(i32 %n)
+; expect: %p = call i32 @ping(i32 %n)
+
+define i32 @top(i32 %x) {
+entry:
+  ; middle and, through it, leaf should both be inlined
+  %r = call i32 @middle(i32 %x)
+  ret i32 %r
+}
+
+define internal i32 @middle(i32 %x) #0 {
+entry:
+  %l = call i32 @leaf(i32 %x)
+  %r = add i32 %l, 1
+  ret i32 %r
+}
+
+define internal i32 @leaf(i32 %x) #0 {
+entry:
+  %r = mul i32 %x, 3
+  ret i32 %r
+}
+
+define i32 @user(i32 %n) {
+entry:
+  ; countdown calls itself and ping calls pong calls ping, both should stay calls
+  %c = call i32 @countdown(i32 %n)
+  %p = call i32 @ping(i32 %n)
+  %r = add i32 %c, %p
+  ret i32 %r
+}
+
+define i32 @countdown(i32 %n) #0 {
+entry:
+  %done = icmp eq i32 %n, 0
+  br i1 %done, label %exit, label %recurse
+
+recurse:
+  %m = sub i32 %n, 1
+  %r = call i32 @countdown(i32 %m)
+  br label %exit
+
+exit:
+  %v = phi i32 [ 0, %entry ], [ %r, %recurse ]
+  ret i32 %v
+}
+
+define i32 @ping(i32 %n) #0 {
+entry:
+  %done = icmp eq i32 %n, 0
+  br i1 %done, label %exit, label %recurse
+
+recurse:
+  %m = sub i32 %n, 1
+  %r = call i32 @pong(i32 %m)
+  br label %exit
+
+exit:
+  %v = phi i32 [ 0, %entry ], [ %r, %recurse ]
+  ret i32 %v
+}
+
+define i32 @pong(i32 %n) #0 {
+entry:
+  %r = call i32 @ping(i32 %n)
+  %v = add i32 %r, 1
+  ret i32 %v
+}
+
+attributes #0 = { alwaysinline }
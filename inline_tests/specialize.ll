@@ -0,0 +1,69 @@
+; Test file for -my-specialize
+; Callees called twice with the same constants get a clone with them folded
+; in. Weak callees are left alone, the linker may pick another body. An
+; ordered atomic load of a constant folds but can never be erased, which must
+; not keep constant propagation going forever.
+; passes: -my-specialize
+; expect: %a = call i32 @scale.spec(i32 %x, i32 4)
+; expect: %b = call i32 @scale.spec(i32 %y, i32 4)
+; expect: %v = call i32 @weak_scale(i32 %x, i32 4)
+; expect: %u = call i32 @weak_scale(i32 %y, i32 4)
+; expect-not: @weak_scale.spec
+; expect: %l = call i32 @atomic_read.spec(i32 %x, i32 1)
+; expect: %k = call i32 @atomic_read.spec(i32 %y, i32 1)
+
+@limit = constant i32 64
+
+define i32 @caller(i32 %x, i32 %y) {
+entry:
+  %a = call i32 @scale(i32 %x, i32 4)
+  %b = call i32 @scale(i32 %y, i32 4)
+  %v = call i32 @weak_scale(i32 %x, i32 4)
+  %u = call i32 @weak_scale(i32 %y, i32 4)
+  %l = call i32 @atomic_read(i32 %x, i32 1)
+  %k = call i32 @atomic_read(i32 %y, i32 1)
+  %t1 = add i32 %a, %b
+  %t2 = add i32 %v, %u
+  %t3 = add i32 %l, %k
+  %t4 = add i32 %t1, %t2
+  %r = add i32 %t3, %t4
+  ret i32 %r
+}
+
+define i32 @scale(i32 %x, i32 %s) {
+entry:
+  %big = icmp ugt i32 %s, 8
+  br i1 %big, label %wide, label %narrow
+
+wide:
+  %w = mul i32 %x, %s
+  br label %exit
+
+narrow:
+  %n = shl i32 %x, %s
+  br label %exit
+
+exit:
+  %r = phi i32 [ %w, %wide ], [ %n, %narrow ]
+  ret i32 %r
+}
+
+define weak i32 @weak_scale(i32 %x, i32 %s) {
+entry:
+  %r = mul i32 %x, %s
+  ret i32 %r
+}
+
+define i32 @atomic_read(i32 %x, i32 %on) {
+entry:
+  %c = icmp eq i32 %on, 0
+  br i1 %c, label %off, label %read
+
+read:
+  %lim = load atomic i32, ptr @limit seq_cst, align 4
+  %r = add i32 %x, %lim
+  ret i32 %r
+
+off:
+  ret i32 %x
+}
@@ -0,0 +1,119 @@
+; Test file for merging stack slots after inlining
+; Slots whose lifetime markers show they are never live together share one
+; slot; overlapping ones, ones used outside their markers and ones of another
+; type or count keep their own. Each function inlines @touch, merging only
+; runs on callers that changed.
+; expect-not: %m1b = alloca
+; expect: %m2a = alloca
+; expect: %m2b = alloca
+; expect: %m3a = alloca
+; expect: %m3b = alloca
+; expect: %m4a = alloca
+; expect: %m4b = alloca
+; expect: %m4c = alloca
+; expect: %m4d = alloca
+; expect: %m5a = alloca
+; expect: %m5b = alloca
+; expect-not: call void @touch(
+
+declare void @use(ptr)
+declare void @llvm.lifetime.start.p0(i64, ptr)
+declare void @llvm.lifetime.end.p0(i64, ptr)
+
+define void @touch() #0 {
+entry:
+  ret void
+}
+
+define void @disjoint() {
+entry:
+  ; m1a is dead before m1b starts, m1b should become m1a
+  %m1a = alloca [16 x i32], align 4
+  %m1b = alloca [16 x i32], align 16
+  call void @touch()
+  call void @llvm.lifetime.start.p0(i64 64, ptr %m1a)
+  call void @use(ptr %m1a)
+  call void @llvm.lifetime.end.p0(i64 64, ptr %m1a)
+  call void @llvm.lifetime.start.p0(i64 64, ptr %m1b)
+  call void @use(ptr %m1b)
+  call void @llvm.lifetime.end.p0(i64 64, ptr %m1b)
+  ret void
+}
+
+define void @overlapping() {
+entry:
+  ; m2b starts while m2a is still live
+  %m2a = alloca [16 x i32], align 4
+  %m2b = alloca [16 x i32], align 4
+  call void @touch()
+  call void @llvm.lifetime.start.p0(i64 64, ptr %m2a)
+  call void @llvm.lifetime.start.p0(i64 64, ptr %m2b)
+  call void @use(ptr %m2a)
+  call void @use(ptr %m2b)
+  call void @llvm.lifetime.end.p0(i64 64, ptr %m2a)
+  call void @llvm.lifetime.end.p0(i64 64, ptr %m2b)
+  ret void
+}
+
+define void @escaped() {
+entry:
+  ; the address of m3a is handed out before its lifetime starts, so the
+  ; markers do not tell when it is in use
+  %m3a = alloca [16 x i32], align 4
+  %m3b = alloca [16 x i32], align 4
+  call void @touch()
+  call void @use(ptr %m3a)
+  call void @llvm.lifetime.start.p0(i64 64, ptr %m3a)
+  call void @use(ptr %m3a)
+  call void @llvm.lifetime.end.p0(i64 64, ptr %m3a)
+  call void @llvm.lifetime.start.p0(i64 64, ptr %m3b)
+  call void @use(ptr %m3b)
+  call void @llvm.lifetime.end.p0(i64 64, ptr %m3b)
+  ret void
+}
+
+define void @different_shapes() {
+entry:
+  ; disjoint, but m4a and m4b differ in type and m4c and m4d in count
+  %m4a = alloca [16 x i32], align 4
+  %m4b = alloca [16 x i8], align 4
+  %m4c = alloca i32, i32 4, align 4
+  %m4d = alloca i32, i32 8, align 4
+  call void @touch()
+  call void @llvm.lifetime.start.p0(i64 64, ptr %m4a)
+  call void @use(ptr %m4a)
+  call void @llvm.lifetime.end.p0(i64 64, ptr %m4a)
+  call void @llvm.lifetime.start.p0(i64 16, ptr %m4b)
+  call void @use(ptr %m4b)
+  call void @llvm.lifetime.end.p0(i64 16, ptr %m4b)
+  call void @llvm.lifetime.start.p0(i64 16, ptr %m4c)
+  call void @use(ptr %m4c)
+  call void @llvm.lifetime.end.p0(i64 16, ptr %m4c)
+  call void @llvm.lifetime.start.p0(i64 32, ptr %m4d)
+  call void @use(ptr %m4d)
+  call void @llvm.lifetime.end.p0(i64 32, ptr %m4d)
+  ret void
+}
+
+define void @live_on_one_path(i1 %c) {
+entry:
+  ; m5a only ends on the then path, so it may still be live where m5b starts
+  %m5a = alloca [16 x i32], align 4
+  %m5b = alloca [16 x i32], align 4
+  call void @touch()
+  call void @llvm.lifetime.start.p0(i64 64, ptr %m5a)
+  call void @use(ptr %m5a)
+  br i1 %c, label %then, label %join
+
+then:
+  call void @llvm.lifetime.end.p0(i64 64, ptr %m5a)
+  br label %join
+
+join:
+  call void @llvm.lifetime.start.p0(i64 64, ptr %m5b)
+  call void @use(ptr %m5b)
+  call void @llvm.lifetime.end.p0(i64 64, ptr %m5b)
+  ret void
+}
+
+attributes #0 = { alwaysinline }
@@ -0,0 +1,29 @@
+; Test file for the compile-time budget
+; With a budget of 5, inlining the last call (1 + 4 instructions) degrades
+; my-always-inline, the middle one exhausts it and the first call stays
+; passes: -my-always-inline -my-inline-work-budget=5 -pass-remarks-missed=my-always-inline
+; expect: %a = call i32 @mix(i32 %x)
+; expect-not: %b = call i32 @mix(i32 %y)
+; expect-not: %c = call i32 @mix(i32 %z)
+; expect-log: caller: over the function compile-time budget after 5 instructions, switching to cheaper analyses
+; expect-log: caller: over the function compile-time budget after 10 instructions, leaving the rest of the function as it is
+
+define i32 @caller(i32 %x, i32 %y, i32 %z) {
+entry:
+  %a = call i32 @mix(i32 %x)
+  %b = call i32 @mix(i32 %y)
+  %c = call i32 @mix(i32 %z)
+  %s = add i32 %a, %b
+  %r = add i32 %s, %c
+  ret i32 %r
+}
+
+define i32 @mix(i32 %x) #0 {
+entry:
+  %m = mul i32 %x, 31
+  %s = lshr i32 %m, 7
+  %r = xor i32 %m, %s
+  ret i32 %r
+}
+
+attributes #0 = { alwaysinline }
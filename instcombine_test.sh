@@ -1,7 +1,54 @@
 #!/bin/bash
+# Runs my-inst-combine on every instcombine_tests/*.ll. A test may set more
+# options and check the output or the log (stderr), in its comments:
+#   ; flags: -my-inst-combine-work-budget=3 -pass-remarks-missed=my-inst-combine
+#   ; expect: add i32 %e, 0
+#   ; expect-not: mul i32 %x, 1
+#   ; expect-log: switching to cheaper analyses
+# Every output must pass the verifier. Exits non-zero if any check fails.
 shopt -s nullglob dotglob
 
-for src in ./build/instcombine_tests/*.ll; do	
-	echo "Compiling $(basename "$src" .ll)"
-	./build/bin/opt --load ./build/lib/MyInstCombine.so --bugpoint-enable-legacy-pm -my-inst-combine -S $src -o ./build/instcombine_tests/$(basename "$src" .ll)_after.ll
+OPT="./build/bin/opt"
+FAILED=0
+
+for src in ./build/instcombine_tests/*.ll; do
+	# outputs of an earlier run
+	[[ "$src" == *_after.ll ]] && continue
+	base=$(basename "$src" .ll)
+	out="./build/instcombine_tests/${base}_after.ll"
+	log="./build/instcombine_tests/$base.log"
+	read -r -a flags <<< "$(sed -n 's|^; flags: ||p' "$src")"
+
+	echo "Compiling $base"
+	if ! "$OPT" --load ./build/lib/MyInstCombine.so --bugpoint-enable-legacy-pm -my-inst-combine \
+			${flags[@]+"${flags[@]}"} -S "$src" -o "$out" 2>"$log"; then
+		echo "❌ $base: opt failed, see $log"
+		FAILED=1
+		continue
+	fi
+	if ! "$OPT" -passes=verify -disable-output "$out" 2>>"$log"; then
+		echo "❌ $base: $out does not verify, see $log"
+		FAILED=1
+	fi
+
+	while IFS= read -r line; do
+		if ! grep -qF -- "$line" "$out"; then
+			echo "❌ $base: expected \"$line\" in $out"
+			FAILED=1
+		fi
+	done < <(sed -n 's|^; expect: ||p' "$src")
+	while IFS= read -r line; do
+		if grep -qF -- "$line" "$out"; then
+			echo "❌ $base: did not expect \"$line\" in $out"
+			FAILED=1
+		fi
+	done < <(sed -n 's|^; expect-not: ||p' "$src")
+	while IFS= read -r line; do
+		if ! grep -qF -- "$line" "$log"; then
+			echo "❌ $base: expected \"$line\" in $log"
+			FAILED=1
+		fi
+	done < <(sed -n 's|^; expect-log: ||p' "$src")
 done
+
+exit $FAILED
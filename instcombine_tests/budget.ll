@@ -0,0 +1,18 @@
+; Test file for the compile-time budget
+; With a budget of 3 instructions, my-inst-combine degrades at the third
+; instruction and stops at the sixth, before folding x + 0 away
+; flags: -my-inst-combine-work-budget=3 -pass-remarks-missed=my-inst-combine
+; expect: %keep = add i32 %e, 0
+; expect-log: over the function compile-time budget after 3 instructions, switching to cheaper analyses
+; expect-log: over the function compile-time budget after 6 instructions, leaving the rest of the function as it is
+
+define i32 @test_budget(i32 %x, i32 %y) {
+entry:
+  %a = mul i32 %x, %y
+  %b = mul i32 %a, %y
+  %c = mul i32 %b, %y
+  %d = mul i32 %c, %y
+  %e = mul i32 %d, %y
+  %keep = add i32 %e, 0
+  ret i32 %keep
+}
@@ -0,0 +1,82 @@
+; Test file for cast-chain and GEP-chain folding
+; Chains of casts collapse into one cast, chains of constant GEPs into one byte offset
+
+%struct.inner = type { i32, i32, [4 x i16] }
+%struct.outer = type { i64, %struct.inner, i8 }
+
+define i64 @test_ext_chains(i8 %x) {
+entry:
+  ; zext (zext X) should become zext X
+  %z1 = zext i8 %x to i16
+  %z2 = zext i16 %z1 to i64
+
+  ; sext (sext X) should become sext X
+  %s1 = sext i8 %x to i32
+  %s2 = sext i32 %s1 to i64
+
+  ; sext (zext X) should become zext X
+  %zs1 = zext i8 %x to i16
+  %zs2 = sext i16 %zs1 to i64
+
+  %temp = add i64 %z2, %s2
+  %result = add i64 %temp, %zs2
+  ret i64 %result
+}
+
+define i32 @test_trunc_chains(i16 %x, i64 %y) {
+entry:
+  ; trunc (zext X) back to the type of X should become X
+  %z = zext i16 %x to i64
+  %t1 = trunc i64 %z to i16
+
+  ; trunc (sext X) to a wider type than X should become sext X
+  %s = sext i16 %x to i64
+  %t2 = trunc i64 %s to i32
+
+  ; trunc (trunc Y) should become trunc Y
+  %tt1 = trunc i64 %y to i32
+  %tt2 = trunc i32 %tt1 to i16
+
+  ; zext (trunc Y) back to the type of Y should become Y & 0xFFFFFFFF
+  %zt = zext i32 %tt1 to i64
+  %zt.t = trunc i64 %zt to i32
+
+  %a = zext i16 %t1 to i32
+  %b = zext i16 %tt2 to i32
+  %temp1 = add i32 %a, %t2
+  %temp2 = add i32 %b, %zt.t
+  %result = add i32 %temp1, %temp2
+  ret i32 %result
+}
+
+define i32 @test_non_integer_round_trips(i32 %x, i64 %p) {
+entry:
+  ; (int)(float)x goes through a float and may round, must stay
+  %f = sitofp i32 %x to float
+  %fi = fptosi float %f to i32
+
+  ; ptrtoint (inttoptr P) goes through a pointer, must stay
+  %ptr = inttoptr i64 %p to ptr
+  %pi = ptrtoint ptr %ptr to i64
+  %pt = trunc i64 %pi to i32
+
+  %result = add i32 %fi, %pt
+  ret i32 %result
+}
+
+define ptr @test_struct_gep_chain(ptr %p) {
+entry:
+  ; &p->inner.arr[2] through three GEPs should become one i8 GEP with offset 20
+  %inner = getelementptr inbounds %struct.outer, ptr %p, i32 0, i32 1
+  %arr = getelementptr inbounds %struct.inner, ptr %inner, i32 0, i32 2
+  %elt = getelementptr inbounds [4 x i16], ptr %arr, i64 0, i64 2
+  ret ptr %elt
+}
+
+define ptr @test_gep_chain_cancels(ptr %p) {
+entry:
+  ; +8 followed by -8 should become %p
+  %fwd = getelementptr i64, ptr %p, i64 1
+  %back = getelementptr i64, ptr %fwd, i64 -1
+  ret ptr %back
+}
@@ -0,0 +1,102 @@
+; Test file for idiom recognition
+; Shift/mask trees and compare-select pairs should become the intrinsic they compute
+
+define i32 @test_rotate_const(i32 %x) {
+entry:
+  ; (X << 7) | (X >> 25) should become fshl(X, X, 7)
+  %shl = shl i32 %x, 7
+  %shr = lshr i32 %x, 25
+  %rot = or i32 %shl, %shr
+  ret i32 %rot
+}
+
+define i32 @test_rotate_var(i32 %x, i32 %s) {
+entry:
+  ; (X >> (32 - S)) | (X << S) should become fshl(X, X, S)
+  %inv = sub i32 32, %s
+  %shr = lshr i32 %x, %inv
+  %shl = shl i32 %x, %s
+  %rot = or i32 %shr, %shl
+  ret i32 %rot
+}
+
+define i32 @test_bswap32(i32 %x) {
+entry:
+  ; Byte reversal assembled from shifts and masks should become bswap(X)
+  %b0 = shl i32 %x, 24
+  %t1 = shl i32 %x, 8
+  %b1 = and i32 %t1, 16711680
+  %t2 = lshr i32 %x, 8
+  %b2 = and i32 %t2, 65280
+  %b3 = lshr i32 %x, 24
+  %o1 = or i32 %b0, %b1
+  %o2 = or i32 %b2, %b3
+  %swap = or i32 %o1, %o2
+  ret i32 %swap
+}
+
+define i16 @test_bswap16(i16 %x) {
+entry:
+  ; (X << 8) | (X >> 8) on i16 should become bswap(X)
+  %hi = shl i16 %x, 8
+  %lo = lshr i16 %x, 8
+  %swap = or i16 %hi, %lo
+  ret i16 %swap
+}
+
+define i32 @test_not_bswap(i32 %x) {
+entry:
+  ; Moves a byte to the wrong place, should stay
+  %b0 = shl i32 %x, 24
+  %b3 = lshr i32 %x, 16
+  %r = or i32 %b0, %b3
+  ret i32 %r
+}
+
+define i32 @test_min_max(i32 %a, i32 %b) {
+entry:
+  ; select (a < b), a, b should become smin(a, b)
+  %c1 = icmp slt i32 %a, %b
+  %smin = select i1 %c1, i32 %a, i32 %b
+
+  ; select (a < b), b, a should become smax(a, b)
+  %smax = select i1 %c1, i32 %b, i32 %a
+
+  ; select (a >u b), a, b should become umax(a, b)
+  %c2 = icmp ugt i32 %a, %b
+  %umax = select i1 %c2, i32 %a, i32 %b
+
+  ; select (a <=u 255), a, 255 should become umin(a, 255)
+  %c3 = icmp ule i32 %a, 255
+  %umin = select i1 %c3, i32 %a, i32 255
+
+  %t1 = add i32 %smin, %smax
+  %t2 = add i32 %umax, %umin
+  %result = add i32 %t1, %t2
+  ret i32 %result
+}
+
+define i32 @test_abs(i32 %x) {
+entry:
+  ; select (x < 0), -x, x should become abs(x)
+  %neg = sub nsw i32 0, %x
+  %c1 = icmp slt i32 %x, 0
+  %abs1 = select i1 %c1, i32 %neg, i32 %x
+
+  ; select (x > -1), x, -x should become abs(x)
+  %c2 = icmp sgt i32 %x, -1
+  %abs2 = select i1 %c2, i32 %x, i32 %neg
+
+  %result = add i32 %abs1, %abs2
+  ret i32 %result
+}
+
+@g = global i32 0
+
+define i64 @test_abs_const_expr() {
+entry:
+  ; -x here is a constant expression, not an instruction; abs without nsw
+  %c = icmp slt i64 ptrtoint (ptr @g to i64), 0
+  %abs = select i1 %c, i64 sub (i64 0, i64 ptrtoint (ptr @g to i64)), i64 ptrtoint (ptr @g to i64)
+  ret i64 %abs
+}
@@ -0,0 +1,83 @@
+; Test file for known-bits and demanded-bits driven simplifications
+; Masks, round trips and divisions are resolved from the bits each value can have
+
+define i32 @test_redundant_masks(i32 %x) {
+entry:
+  ; (X << 8) & 0xFF has no bits left, should become 0
+  %shl = shl i32 %x, 8
+  %low = and i32 %shl, 255
+
+  ; (X & 0xF0) & 0xFF only clears bits that are already zero, should become X & 0xF0
+  %nib = and i32 %x, 240
+  %same = and i32 %nib, 255
+
+  ; (X | 0x100) | 0x100 sets a bit that is already set
+  %set = or i32 %x, 256
+  %set2 = or i32 %set, 256
+
+  %temp = add i32 %low, %same
+  %result = add i32 %temp, %set2
+  ret i32 %result
+}
+
+define i32 @test_disjoint_or(i32 %hi, i8 %lo) {
+entry:
+  ; ((hi << 8) | zext lo) & 0xFF only demands the low byte, should become zext lo
+  %shl = shl i32 %hi, 8
+  %ext = zext i8 %lo to i32
+  %packed = or i32 %shl, %ext
+  %byte = and i32 %packed, 255
+  ret i32 %byte
+}
+
+define i8 @test_trunc_of_packed(i32 %hi, i8 %lo) {
+entry:
+  ; trunc ((hi << 8) | zext lo) should become trunc (zext lo)
+  %shl = shl i32 %hi, 8
+  %ext = zext i8 %lo to i32
+  %packed = or i32 %shl, %ext
+  %t = trunc i32 %packed to i8
+  ret i8 %t
+}
+
+define i32 @test_narrowed_operand_flags(i32 %y, i32 %hi) {
+entry:
+  ; shl nuw (Y & 0xFF), 24 should become shl Y, 24 without nuw, Y may have higher bits
+  %m = and i32 %y, 255
+  %shl = shl nuw i32 %m, 24
+
+  ; (hi & ~0xFF) | 0xFF should become hi | 0xFF without disjoint, hi may have low bits
+  %hm = and i32 %hi, -256
+  %or = or disjoint i32 %hm, 255
+
+  %result = add i32 %shl, %or
+  ret i32 %result
+}
+
+define i32 @test_zext_trunc_round_trip(i32 %x) {
+entry:
+  ; zext (trunc X to i8) & 0xFF should become X & 0xFF
+  %t = trunc i32 %x to i8
+  %z = zext i8 %t to i32
+  %m = and i32 %z, 255
+  ret i32 %m
+}
+
+define i32 @test_signed_div_rem_nonneg(i32 %x) {
+entry:
+  ; X & 0x7FFFFFFF is never negative, so sdiv/srem by 8 become ashr/and
+  %pos = and i32 %x, 2147483647
+  %div = sdiv i32 %pos, 8
+  %rem = srem i32 %pos, 8
+
+  ; X may be negative here, sdiv must stay
+  %keep = sdiv i32 %x, 8
+
+  ; urem by a power of 2 is always a mask
+  %urem = urem i32 %x, 16
+
+  %temp1 = add i32 %div, %rem
+  %temp2 = add i32 %keep, %urem
+  %result = add i32 %temp1, %temp2
+  ret i32 %result
+}
@@ -0,0 +1,96 @@
+; Test file for the in-block memory combines
+; Stores feed later loads directly, dead stores go away, small memcpy/memset become plain accesses
+; expect: load i64, ptr %from, align 4, !tbaa
+; expect: store i64 %memcpy.val, ptr %to, align 4, !tbaa
+; expect: !alias.scope
+; expect: !noalias
+; expect: store i32 0, ptr %to, align 4, !tbaa
+; expect-not: call void @llvm.mem
+; expect-not: !tbaa.struct
+
+define i32 @test_store_to_load(ptr %p, i32 %x) {
+entry:
+  ; The load should use X directly
+  store i32 %x, ptr %p
+  %v = load i32, ptr %p
+  ret i32 %v
+}
+
+define i32 @test_load_after_load(ptr %p) {
+entry:
+  ; The second load should reuse the first
+  %a = load i32, ptr %p
+  %b = load i32, ptr %p
+  %r = add i32 %a, %b
+  ret i32 %r
+}
+
+define i32 @test_clobbered(ptr %p, ptr %q, i32 %x) {
+entry:
+  ; q may alias p, so the load must stay
+  store i32 %x, ptr %p
+  store i32 0, ptr %q
+  %v = load i32, ptr %p
+  ret i32 %v
+}
+
+define i32 @test_no_alias(ptr noalias %p, ptr noalias %q, i32 %x) {
+entry:
+  ; q does not alias p, the load should use X
+  store i32 %x, ptr %p
+  store i32 0, ptr %q
+  %v = load i32, ptr %p
+  ret i32 %v
+}
+
+define void @test_dead_store(ptr %p, i32 %x, i32 %y) {
+entry:
+  ; The first store is overwritten before any read and should be removed
+  store i32 %x, ptr %p
+  store i32 %y, ptr %p
+  ret void
+}
+
+define void @test_small_memcpy(ptr %dst, ptr %src) {
+entry:
+  ; An 8 byte struct copy should become one i64 load and store
+  call void @llvm.memcpy.p0.p0.i64(ptr align 4 %dst, ptr align 4 %src, i64 8, i1 false)
+  ret void
+}
+
+define void @test_small_memset(ptr %dst, i8 %b) {
+entry:
+  ; A 16 byte zero fill should become one i128 store
+  call void @llvm.memset.p0.i64(ptr align 8 %dst, i8 0, i64 16, i1 false)
+
+  ; A 4 byte fill with a variable byte should splat it with a multiply
+  %tail = getelementptr inbounds i8, ptr %dst, i64 16
+  call void @llvm.memset.p0.i64(ptr align 4 %tail, i8 %b, i64 4, i1 false)
+  ret void
+}
+
+define void @test_small_mem_aa_metadata(ptr %to, ptr %from) {
+entry:
+  ; The load and store should keep the memcpy's TBAA tag and scopes
+  call void @llvm.memcpy.p0.p0.i64(ptr align 4 %to, ptr align 4 %from, i64 8, i1 false), !tbaa !0, !alias.scope !4, !noalias !7
+
+  ; The single 4 byte field of the tbaa.struct should become the store's TBAA tag
+  call void @llvm.memset.p0.i64(ptr align 4 %to, i8 0, i64 4, i1 false), !tbaa.struct !9
+  ret void
+}
+
+declare void @llvm.memcpy.p0.p0.i64(ptr, ptr, i64, i1)
+declare void @llvm.memset.p0.i64(ptr, i8, i64, i1)
+
+!0 = !{!1, !1, i64 0}
+!1 = !{!"long", !2, i64 0}
+!2 = !{!"omnipotent char", !3, i64 0}
+!3 = !{!"Simple C/C++ TBAA"}
+!4 = !{!5}
+!5 = distinct !{!5, !6, !"copy: dst"}
+!6 = distinct !{!6, !"copy"}
+!7 = !{!8}
+!8 = distinct !{!8, !6, !"copy: src"}
+!9 = !{i64 0, i64 4, !10}
+!10 = !{!11, !11, i64 0}
+!11 = !{!"int", !2, i64 0}
@@ -0,0 +1,86 @@
+; Test file for PHI and select folding
+; Merge points and selects produced by inlining should shrink
+
+define i32 @test_phi_of_adds(i1 %c, i32 %a, i32 %b) {
+entry:
+  br i1 %c, label %left, label %right
+
+left:
+  %a1 = add nsw i32 %a, 1
+  br label %merge
+
+right:
+  %b1 = add nsw i32 %b, 1
+  br label %merge
+
+merge:
+  ; phi [a + 1], [b + 1] should become (phi [a], [b]) + 1, keeping nsw
+  %p = phi i32 [ %a1, %left ], [ %b1, %right ]
+  ret i32 %p
+}
+
+define i32 @test_phi_same_incoming(i1 %c, i32 %x) {
+entry:
+  br i1 %c, label %left, label %right
+
+left:
+  br label %merge
+
+right:
+  br label %merge
+
+merge:
+  ; Every incoming value is X, should become X
+  %p = phi i32 [ %x, %left ], [ %x, %right ]
+  ret i32 %p
+}
+
+define i32 @test_select_same_arms(i1 %c, i32 %x) {
+entry:
+  ; select C, X, X should become X
+  %s = select i1 %c, i32 %x, i32 %x
+
+  ; select true, X, 7 should become X
+  %t = select i1 true, i32 %s, i32 7
+  ret i32 %t
+}
+
+define i32 @test_select_bool_consts(i1 %c) {
+entry:
+  ; select C, 1, 0 should become zext C
+  %z = select i1 %c, i32 1, i32 0
+
+  ; select C, -1, 0 should become sext C
+  %s = select i1 %c, i32 -1, i32 0
+
+  ; select C, 0, 1 should become zext (not C)
+  %nz = select i1 %c, i32 0, i32 1
+
+  %t = add i32 %z, %s
+  %result = add i32 %t, %nz
+  ret i32 %result
+}
+
+define i1 @test_select_i1(i1 %c) {
+entry:
+  ; select C, false, true should become not C
+  %n = select i1 %c, i1 false, i1 true
+  ret i1 %n
+}
+
+define <4 x i1> @test_select_vector_i1(<4 x i1> %c) {
+entry:
+  ; the same on vectors should become C xor all ones
+  %n = select <4 x i1> %c, <4 x i1> zeroinitializer, <4 x i1> <i1 true, i1 true, i1 true, i1 true>
+  %id = select <4 x i1> %c, <4 x i1> <i1 true, i1 true, i1 true, i1 true>, <4 x i1> zeroinitializer
+  %r = and <4 x i1> %n, %id
+  ret <4 x i1> %r
+}
+
+define i32 @test_binop_into_select(i1 %c) {
+entry:
+  ; (select C, 10, 20) + 5 should become select C, 15, 25
+  %s = select i1 %c, i32 10, i32 20
+  %r = add i32 %s, 5
+  ret i32 %r
+}
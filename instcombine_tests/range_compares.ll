@@ -0,0 +1,77 @@
+; Test file for range-based comparison folding
+; Compares decided by value ranges or by dominating branches should fold away
+
+define i1 @test_range_from_known_bits(i32 %x) {
+entry:
+  ; (X & 15) < 16 is always true
+  %low = and i32 %x, 15
+  %c1 = icmp ult i32 %low, 16
+
+  ; (X urem 10) > 20 is always false
+  %rem = urem i32 %x, 10
+  %c2 = icmp ugt i32 %rem, 20
+
+  %result = or i1 %c1, %c2
+  ret i1 %result
+}
+
+define i1 @test_impossible_pair(i32 %x) {
+entry:
+  ; X < 5 && X > 10 can never hold
+  %lt = icmp slt i32 %x, 5
+  %gt = icmp sgt i32 %x, 10
+  %both = and i1 %lt, %gt
+  ret i1 %both
+}
+
+define i1 @test_tautological_pair(i32 %x) {
+entry:
+  ; X < 10 || X > 5 always holds
+  %lt = icmp slt i32 %x, 10
+  %gt = icmp sgt i32 %x, 5
+  %either = or i1 %lt, %gt
+  ret i1 %either
+}
+
+define i1 @test_merged_pair(i32 %x) {
+entry:
+  ; X <u 100 && X <u 10 should become X <u 10
+  %c1 = icmp ult i32 %x, 100
+  %c2 = icmp ult i32 %x, 10
+  %both = and i1 %c1, %c2
+  ret i1 %both
+}
+
+define i32 @test_bounds_check(ptr %arr, i32 %i) {
+entry:
+  ; i <u 10 is tested first, the inner i <u 16 bounds check should fold to true
+  %in = icmp ult i32 %i, 10
+  br i1 %in, label %check, label %out
+
+check:
+  %safe = icmp ult i32 %i, 16
+  br i1 %safe, label %load, label %out
+
+load:
+  %idx = zext i32 %i to i64
+  %p = getelementptr inbounds i32, ptr %arr, i64 %idx
+  %v = load i32, ptr %p
+  ret i32 %v
+
+out:
+  ret i32 -1
+}
+
+define i1 @test_same_condition(i32 %a, i32 %b) {
+entry:
+  ; a < b on the false edge, so b > a must be false there
+  %lt = icmp slt i32 %a, %b
+  br i1 %lt, label %yes, label %no
+
+yes:
+  ret i1 true
+
+no:
+  %gt = icmp sgt i32 %b, %a
+  ret i1 %gt
+}
@@ -41,11 +41,14 @@ entry:
 
 define i32 @test_sdiv_power_of_2(i32 %x) {
 entry:
+  ; Signed division only becomes a shift for a non-negative dividend
+  %pos = and i32 %x, 2147483647
+
   ; X / 2 should become X >> 1 (signed, arithmetic shift)
-  %div2 = sdiv i32 %x, 2
+  %div2 = sdiv i32 %pos, 2
   
   ; X / 4 should become X >> 2 (signed, arithmetic shift)
-  %div4 = sdiv i32 %x, 4
+  %div4 = sdiv i32 %pos, 4
   
   ; Add results
   %result = add i32 %div2, %div4
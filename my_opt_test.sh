@@ -0,0 +1,85 @@
+#!/bin/bash
+# Checks that my-opt writes the same bitcode whether the function and loop
+# passes run on the whole module in place (-j 0) or on module parts on
+# several threads (-j 4, one function per part), for every
+# instcombine_tests/*.ll and every LICM_tests/*.c, the latter also built with
+# -g. Then runs my_opt_tests/cache.ll with -cache-dir: a second run takes
+# every function from the cache and writes what an uncached run writes,
+# changing a pass option misses on every function and changing one function
+# misses on that one only. Exits non-zero if any check fails.
+shopt -s nullglob dotglob
+
+OUT_DIR="./build/my_opt_tests"
+MY_OPT="./build/bin/my-opt"
+CLANG="./build/bin/clang"
+PLUGINS=(-load ./build/lib/MyAlwaysInline.so -load ./build/lib/MyInstCombine.so -load ./build/lib/LLVMMyLICMPass.so)
+FAILED=0
+
+mkdir -p "$OUT_DIR"
+
+inputs=()
+for src in ./build/instcombine_tests/*.ll; do
+	# outputs of instcombine_test.sh
+	[[ "$src" == *_after.ll ]] && continue
+	inputs+=("$src")
+done
+for src in ./build/LICM_tests/*.c; do
+	base=$(basename "$src" .c)
+	"$CLANG" -S -emit-llvm -Xclang -disable-O0-optnone "$src" -o "$OUT_DIR/$base.ll"
+	"$CLANG" -S -emit-llvm -g -Xclang -disable-O0-optnone "$src" -o "$OUT_DIR/${base}_g.ll"
+	inputs+=("$OUT_DIR/$base.ll" "$OUT_DIR/${base}_g.ll")
+done
+
+for src in "${inputs[@]}"; do
+	base=$(basename "$src" .ll)
+	echo "Comparing $base"
+	if ! "$MY_OPT" "${PLUGINS[@]}" -j 0 "$src" -o "$OUT_DIR/$base.serial.bc" 2>"$OUT_DIR/$base.serial.log"; then
+		echo "❌ $base: my-opt -j 0 failed, see $OUT_DIR/$base.serial.log"
+		FAILED=1
+		continue
+	fi
+	if ! "$MY_OPT" "${PLUGINS[@]}" -j 4 -part-size=1 "$src" -o "$OUT_DIR/$base.parts.bc" 2>"$OUT_DIR/$base.parts.log"; then
+		echo "❌ $base: my-opt -j 4 failed, see $OUT_DIR/$base.parts.log"
+		FAILED=1
+		continue
+	fi
+	if ! cmp -s "$OUT_DIR/$base.serial.bc" "$OUT_DIR/$base.parts.bc"; then
+		echo "❌ $base: -j 0 and -j 4 outputs differ"
+		FAILED=1
+	fi
+done
+
+# Prints "<hits> <misses>" of a cached run of $1 writing $2, with the options that follow
+CACHE_DIR="$OUT_DIR/cache"
+cached_run() {
+	local src=$1 out=$2
+	shift 2
+	"$MY_OPT" "${PLUGINS[@]}" --pipeline=my-inst-combine,my-licm -cache-dir="$CACHE_DIR" -cache-stats "$@" \
+		"$src" -o "$out" 2>&1 >/dev/null | sed -n 's/^function cache .*: \([0-9]*\) hits, \([0-9]*\) misses.*/\1 \2/p'
+}
+expect_stats() {
+	if [[ "$3" != "$2" ]]; then
+		echo "❌ cache, $1: expected \"$2\" hits and misses, got \"$3\""
+		FAILED=1
+	fi
+}
+
+echo "Checking the function cache"
+rm -rf "$CACHE_DIR"
+src="$OUT_DIR/cache.ll"
+"$MY_OPT" "${PLUGINS[@]}" --pipeline=my-inst-combine,my-licm "$src" -o "$OUT_DIR/cache.uncached.bc" 2>/dev/null
+expect_stats "first run" "0 3" "$(cached_run "$src" "$OUT_DIR/cache.first.bc")"
+expect_stats "second run" "3 0" "$(cached_run "$src" "$OUT_DIR/cache.second.bc")"
+for run in first second; do
+	if ! cmp -s "$OUT_DIR/cache.uncached.bc" "$OUT_DIR/cache.$run.bc"; then
+		echo "❌ cache, $run run: output differs from the uncached run"
+		FAILED=1
+	fi
+done
+expect_stats "pass option changed" "0 3" \
+	"$(cached_run "$src" "$OUT_DIR/cache.option.bc" -my-inst-combine-max-iterations=50)"
+expect_stats "pass option back" "3 0" "$(cached_run "$src" "$OUT_DIR/cache.second.bc")"
+sed 's/mul i32 %x, 8/mul i32 %x, 16/' "$src" > "$OUT_DIR/cache_edited.ll"
+expect_stats "one function changed" "2 1" "$(cached_run "$OUT_DIR/cache_edited.ll" "$OUT_DIR/cache.edited.bc")"
+
+exit $FAILED
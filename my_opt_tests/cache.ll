@@ -0,0 +1,40 @@
+; Input of the function cache check in my_opt_test.sh, which changes the
+; multiplier in @scale between runs. The source file name is fixed, as it
+; is part of every function's cache key.
+source_filename = "cache.c"
+
+define i32 @sum(ptr %a, i32 %n, i32 %k) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  ; %k * 4 does not change in the loop
+  %k4 = mul i32 %k, 4
+  %p = getelementptr inbounds i32, ptr %a, i32 %i
+  %v = load i32, ptr %p
+  %t = add i32 %v, %k4
+  %s.next = add i32 %s, %t
+  %i.next = add nsw i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret i32 %s.next
+}
+
+define i32 @scale(i32 %x) {
+entry:
+  %m = mul i32 %x, 8
+  %r = add i32 %m, 0
+  ret i32 %r
+}
+
+define i32 @mask(i32 %x) {
+entry:
+  %s = shl i32 %x, 8
+  %m = and i32 %s, 255
+  %r = or i32 %m, %x
+  ret i32 %r
+}